@@ -50,7 +50,8 @@ public class ModdingEx : ModuleRules
 				"Slate",
 				"SlateCore",
 				"ToolWidgets", "Json", "Kismet", "BlueprintGraph", "FileUtilities", "PropertyEditor", "HTTP",
-				"JsonUtilities", "ContentBrowserData"
+				"JsonUtilities", "ContentBrowserData", "Sockets", "Networking", "TargetPlatform",
+				"MessageLog", "PakFile"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -71,6 +72,15 @@ public class ModdingEx : ModuleRules
 		PublicAdditionalLibraries.Add(Path.Combine(LibraryFolder, "zip.lib"));
 		PublicAdditionalLibraries.Add(Path.Combine(LibraryFolder, "zlibstatic.lib"));
 
+		// Only the headers, the zip writer deflates with the zlib that is linked for libzip above
+		PrivateIncludePathModuleNames.Add("zlib");
+
 		var BinaryFolder = Path.Combine(ThirdPartyFolder, "bin");
+
+		if (Target.Platform == UnrealTargetPlatform.Win64)
+		{
+			// Restart Manager, finds the processes that lock the output pak
+			PublicSystemLibraries.Add("Rstrtmgr.lib");
+		}
 	}
 }
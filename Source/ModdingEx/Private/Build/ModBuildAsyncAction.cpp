@@ -0,0 +1,70 @@
+﻿#include "Build/ModBuildAsyncAction.h"
+
+#include "ModBuilder.h"
+
+UModBuildAsyncAction* UModBuildAsyncAction::BuildModAsync(const FString& ModName, bool bIsSameContentError)
+{
+	UModBuildAsyncAction* Action = NewObject<UModBuildAsyncAction>();
+	Action->ModName = ModName;
+	Action->Start = [ModName, bIsSameContentError]
+	{
+		return UModBuilder::BuildModAsync(ModName, bIsSameContentError).Next([](const FModBuildResult& Result)
+		{
+			return Result.bSuccess;
+		});
+	};
+	return Action;
+}
+
+UModBuildAsyncAction* UModBuildAsyncAction::ZipModAsync(const FString& ModName)
+{
+	UModBuildAsyncAction* Action = NewObject<UModBuildAsyncAction>();
+	Action->ModName = ModName;
+	Action->Start = [ModName]
+	{
+		return UModBuilder::ZipModAsync(ModName);
+	};
+	return Action;
+}
+
+UModBuildAsyncAction* UModBuildAsyncAction::PrepareModForReleaseAsync(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies)
+{
+	UModBuildAsyncAction* Action = NewObject<UModBuildAsyncAction>();
+	Action->ModName = ModName;
+	Action->Start = [ModName, WebsiteUrl, Dependencies]
+	{
+		return UModBuilder::PrepareModForReleaseAsync(ModName, WebsiteUrl, Dependencies);
+	};
+	return Action;
+}
+
+void UModBuildAsyncAction::Activate()
+{
+	// Editor utilities have no game instance to register with, so keep the action alive until the work has finished
+	AddToRoot();
+
+	Start().Next([WeakThis = TWeakObjectPtr<UModBuildAsyncAction>(this)](bool bSuccess)
+	{
+		if (UModBuildAsyncAction* Action = WeakThis.Get())
+		{
+			Action->Finish(bSuccess);
+		}
+	});
+}
+
+void UModBuildAsyncAction::Finish(bool bSuccess)
+{
+	check(IsInGameThread());
+
+	if (bSuccess)
+	{
+		OnSuccess.Broadcast(ModName);
+	}
+	else
+	{
+		OnFailure.Broadcast(ModName);
+	}
+
+	RemoveFromRoot();
+	SetReadyToDestroy();
+}
@@ -0,0 +1,238 @@
+﻿#include "Build/ModBuildJob.h"
+
+#include "Editor.h"
+#include "ModdingEx.h"
+#include "Async/Async.h"
+#include "Build/ModCookOutputParser.h"
+#include "Logging/MessageLog.h"
+#include "Logging/TokenizedMessage.h"
+#include "Misc/UObjectToken.h"
+#include "Widgets/Notifications/SNotificationList.h"
+
+namespace
+{
+	constexpr int32 ProgressResolution = 100;
+	constexpr int32 MaxOutputLineLength = 120;
+}
+
+const FName FModBuildJob::MessageLogName = "ModdingEx";
+
+FModBuildJob::FModBuildJob(const FText& Title, FWork Work) : Title(Title), Work(MoveTemp(Work))
+{
+}
+
+TFuture<FModBuildResult> FModBuildJob::Start()
+{
+	check(IsInGameThread());
+
+	StartTime = FPlatformTime::Seconds();
+	StageText = FText::FromString("Starting");
+
+	FMessageLog(MessageLogName).NewPage(Title);
+
+	FNotificationInfo Info(Title);
+	Info.Text = TAttribute<FText>::CreateSP(this, &FModBuildJob::GetStatusText);
+	Info.Image = FAppStyle::GetBrush(TEXT("LevelEditor.RecompileGameCode"));
+	Info.FadeInDuration = 0.1f;
+	Info.FadeOutDuration = 0.5f;
+	Info.ExpireDuration = 3.5f;
+	Info.bUseThrobber = true;
+	Info.bUseSuccessFailIcons = true;
+	Info.bFireAndForget = false;
+	Info.bAllowThrottleWhenFrameRateIsLow = false;
+	Info.ButtonDetails.Add(FNotificationButtonInfo(
+		FText::FromString("Cancel"),
+		FText::FromString("Stop the build, running processes will be terminated"),
+		FSimpleDelegate::CreateSP(this, &FModBuildJob::Cancel),
+		SNotificationItem::CS_Pending));
+
+	Notification = FSlateNotificationManager::Get().AddNotification(Info);
+	if (Notification.IsValid())
+	{
+		Notification->SetCompletionState(SNotificationItem::CS_Pending);
+	}
+
+	ProgressHandle = FSlateNotificationManager::Get().StartProgressNotification(Title, ProgressResolution);
+
+	TSharedRef<FModBuildJob, ESPMode::ThreadSafe> Self = AsShared();
+	Async(EAsyncExecution::Thread, [Self]
+	{
+		FModBuildResult Result = Self->Work(*Self);
+
+		AsyncTask(ENamedThreads::GameThread, [Self, Result = MoveTemp(Result)]() mutable
+		{
+			Self->Finish(MoveTemp(Result));
+		});
+	});
+
+	return Promise.GetFuture();
+}
+
+void FModBuildJob::Cancel()
+{
+	if (bCancelRequested)
+	{
+		return;
+	}
+
+	bCancelRequested = true;
+	UE_LOG(LogModdingEx, Warning, TEXT("%s: Cancel requested"), *Title.ToString());
+
+	FScopeLock Lock(&StatusLock);
+	StageText = FText::FromString("Cancelling...");
+}
+
+void FModBuildJob::SetStage(const FText& InStageText, float InProgress, float InProgressEnd)
+{
+	UE_LOG(LogModdingEx, Log, TEXT("%s: %s"), *Title.ToString(), *InStageText.ToString());
+
+	{
+		FScopeLock Lock(&StatusLock);
+		if (!bCancelRequested)
+		{
+			StageText = InStageText;
+		}
+		LastOutputLine.Empty();
+		StageProgress = InProgress;
+		StageProgressEnd = InProgressEnd;
+	}
+
+	UpdateProgressNotification(InProgress);
+}
+
+void FModBuildJob::AddOutputLine(const FString& Line)
+{
+	UE_LOG(LogModdingEx, Log, TEXT("%s"), *Line);
+
+	if (Line.IsEmpty())
+	{
+		return;
+	}
+
+	const FModParsedOutputLine Parsed = FModCookOutputParser::Parse(Line);
+	switch (Parsed.Type)
+	{
+	case EModOutputLineType::Progress:
+		if (Parsed.TotalPackages > 0)
+		{
+			float Progress = -1.0f;
+			{
+				FScopeLock Lock(&StatusLock);
+				if (StageProgressEnd > StageProgress)
+				{
+					const float Fraction = FMath::Clamp(static_cast<float>(Parsed.CookedPackages) / Parsed.TotalPackages, 0.0f, 1.0f);
+					Progress = FMath::Lerp(StageProgress, StageProgressEnd, Fraction);
+				}
+			}
+
+			if (Progress >= 0.0f)
+			{
+				UpdateProgressNotification(Progress);
+			}
+		}
+		break;
+	case EModOutputLineType::Warning:
+	case EModOutputLineType::Error:
+		AddDiagnostic(Parsed.Type == EModOutputLineType::Error, Parsed.Message, Parsed.AssetPath);
+		break;
+	default:
+		break;
+	}
+
+	FScopeLock Lock(&StatusLock);
+	LastOutputLine = Line.Left(MaxOutputLineLength);
+}
+
+void FModBuildJob::AddDiagnostic(bool bIsError, const FString& Message, const FString& AssetPath)
+{
+	++(bIsError ? NumErrors : NumWarnings);
+
+	AsyncTask(ENamedThreads::GameThread, [bIsError, Message, AssetPath]
+	{
+		const TSharedRef<FTokenizedMessage> TokenizedMessage = FTokenizedMessage::Create(
+			bIsError ? EMessageSeverity::Error : EMessageSeverity::Warning);
+
+		if (!AssetPath.IsEmpty())
+		{
+			TokenizedMessage->AddToken(FAssetNameToken::Create(AssetPath));
+		}
+		TokenizedMessage->AddToken(FTextToken::Create(FText::FromString(Message)));
+
+		FMessageLog(MessageLogName).AddMessage(TokenizedMessage);
+	});
+}
+
+FText FModBuildJob::GetStatusText() const
+{
+	FScopeLock Lock(&StatusLock);
+
+	if (LastOutputLine.IsEmpty())
+	{
+		return FText::Format(FText::FromString("{0}\n{1}"), Title, StageText);
+	}
+
+	return FText::Format(FText::FromString("{0}\n{1}\n{2}"), Title, StageText, FText::FromString(LastOutputLine));
+}
+
+void FModBuildJob::UpdateProgressNotification(float InProgress)
+{
+	const int32 WorkDone = FMath::Clamp(FMath::RoundToInt(InProgress * ProgressResolution), 0, ProgressResolution);
+
+	TWeakPtr<FModBuildJob, ESPMode::ThreadSafe> WeakSelf = AsShared();
+	AsyncTask(ENamedThreads::GameThread, [WeakSelf, WorkDone]
+	{
+		if (const TSharedPtr<FModBuildJob, ESPMode::ThreadSafe> Self = WeakSelf.Pin())
+		{
+			FSlateNotificationManager::Get().UpdateProgressNotification(Self->ProgressHandle, WorkDone);
+		}
+	});
+}
+
+void FModBuildJob::Finish(FModBuildResult Result)
+{
+	check(IsInGameThread());
+
+	Result.DurationSeconds = FPlatformTime::Seconds() - StartTime;
+
+	FSlateNotificationManager::Get().CancelProgressNotification(ProgressHandle);
+
+	{
+		FScopeLock Lock(&StatusLock);
+		StageText = Result.bSuccess
+			            ? FText::Format(FText::FromString("Finished in {0} seconds"), FText::AsNumber(FMath::RoundToInt(Result.DurationSeconds)))
+			            : Result.Error;
+		LastOutputLine.Empty();
+	}
+
+	if (Notification.IsValid())
+	{
+		if (NumErrors > 0 || NumWarnings > 0)
+		{
+			Notification->SetHyperlink(FSimpleDelegate::CreateLambda([]
+			{
+				FMessageLog(MessageLogName).Open();
+			}), FText::Format(FText::FromString("Show {0} Errors, {1} Warnings"), FText::AsNumber(NumErrors.load()), FText::AsNumber(NumWarnings.load())));
+		}
+		else if (!Result.bSuccess && !Result.bCancelled)
+		{
+			Notification->SetHyperlink(FSimpleDelegate::CreateLambda([]
+			{
+				FGlobalTabmanager::Get()->TryInvokeTab(FName("OutputLog"));
+			}), FText::FromString("Show Output Log"));
+		}
+
+		Notification->SetCompletionState(Result.bSuccess ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
+		Notification->ExpireAndFadeout();
+	}
+
+	if (Result.bSuccess)
+	{
+		GEditor->PlayEditorSound(TEXT("/Engine/EditorSounds/Notifications/CompileSuccess_Cue.CompileSuccess_Cue"));
+	}
+	else if (!Result.bCancelled)
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("%s failed: %s"), *Title.ToString(), *Result.Error.ToString());
+	}
+
+	Promise.SetValue(MoveTemp(Result));
+}
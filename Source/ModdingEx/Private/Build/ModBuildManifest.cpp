@@ -0,0 +1,305 @@
+﻿#include "Build/ModBuildManifest.h"
+
+#include "ModdingEx.h"
+#include "Algo/Transform.h"
+#include "Async/ParallelFor.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Hash/Blake3.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	constexpr int32 ManifestVersion = 1;
+
+	bool IsInMod(const FName PackageName, const FString& ModPath)
+	{
+		return PackageName.ToString().StartsWith(ModPath + TEXT("/"));
+	}
+}
+
+FString FModBuildManifest::GetManifestPath(const FString& ModName)
+{
+	return FPaths::ProjectIntermediateDir() / "ModdingEx" / ModName / "BuildManifest.json";
+}
+
+FString FModBuildManifest::HashFile(const FString& Filename)
+{
+	const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename));
+	if (!Reader)
+	{
+		return FString();
+	}
+
+	FBlake3 Hasher;
+	TArray<uint8> Buffer;
+	Buffer.SetNumUninitialized(256 * 1024);
+
+	int64 Remaining = Reader->TotalSize();
+	while (Remaining > 0)
+	{
+		const int64 ChunkSize = FMath::Min<int64>(Remaining, Buffer.Num());
+		Reader->Serialize(Buffer.GetData(), ChunkSize);
+		Hasher.Update(Buffer.GetData(), ChunkSize);
+		Remaining -= ChunkSize;
+	}
+
+	FBlake3Hash Hash = Hasher.Finalize();
+	return BytesToHex(Hash.GetBytes(), sizeof(FBlake3Hash::ByteArray));
+}
+
+FModBuildManifest FModBuildManifest::Capture(const FString& ModName, const FModBuildManifest* Previous)
+{
+	FModBuildManifest Manifest;
+	Manifest.ModPath = FString("/Game") / "Mods" / ModName;
+
+	const FString ModContentDir = FPaths::ProjectContentDir() / "Mods" / ModName;
+
+	TArray<FString> ModFiles;
+	IFileManager::Get().FindFilesRecursive(ModFiles, *ModContentDir, TEXT("*.uasset"), true, false);
+	IFileManager::Get().FindFilesRecursive(ModFiles, *ModContentDir, TEXT("*.umap"), true, false, false);
+
+	TArray<FName> PackageNames;
+	TArray<FString> Filenames;
+	TSet<FName> Visited;
+
+	for (const FString& Filename : ModFiles)
+	{
+		FString PackageName;
+		if (FPackageName::TryConvertFilenameToLongPackageName(Filename, PackageName))
+		{
+			PackageNames.Add(*PackageName);
+			Filenames.Add(Filename);
+			Visited.Add(*PackageName);
+		}
+	}
+
+	// Walk the hard dependencies so changes to shared assets outside the mod dirty their referencers as well
+	const IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+	for (int32 Index = 0; Index < PackageNames.Num(); ++Index)
+	{
+		TArray<FName> Dependencies;
+		AssetRegistry.GetDependencies(PackageNames[Index], Dependencies, UE::AssetRegistry::EDependencyCategory::Package,
+		                              UE::AssetRegistry::EDependencyQuery::Hard);
+
+		FModBuildManifestEntry& Entry = Manifest.Packages.Add(PackageNames[Index]);
+
+		for (const FName Dependency : Dependencies)
+		{
+			const FString DependencyString = Dependency.ToString();
+			if (!DependencyString.StartsWith(TEXT("/Game/")))
+			{
+				continue;
+			}
+
+			Entry.Dependencies.Add(Dependency);
+
+			FString DependencyFilename;
+			if (!Visited.Contains(Dependency) && FPackageName::DoesPackageExist(DependencyString, &DependencyFilename))
+			{
+				PackageNames.Add(Dependency);
+				Filenames.Add(FPaths::ConvertRelativePathToFull(DependencyFilename));
+			}
+			Visited.Add(Dependency);
+		}
+	}
+
+	ParallelFor(Filenames.Num(), [&Manifest, &PackageNames, &Filenames, Previous](int32 Index)
+	{
+		// Only the entries are written here, the map itself isn't modified anymore
+		FModBuildManifestEntry& Entry = Manifest.Packages[PackageNames[Index]];
+
+		const FFileStatData Stat = IFileManager::Get().GetStatData(*Filenames[Index]);
+		Entry.Size = Stat.bIsValid ? Stat.FileSize : -1;
+		Entry.Timestamp = Stat.ModificationTime;
+
+		const FModBuildManifestEntry* PreviousEntry = Previous ? Previous->Packages.Find(PackageNames[Index]) : nullptr;
+		if (PreviousEntry && Entry.Size >= 0 && PreviousEntry->Size == Entry.Size && PreviousEntry->Timestamp == Entry.Timestamp)
+		{
+			Entry.Hash = PreviousEntry->Hash;
+		}
+		else
+		{
+			Entry.Hash = HashFile(Filenames[Index]);
+		}
+	});
+
+	return Manifest;
+}
+
+bool FModBuildManifest::Load(const FString& ModName, FModBuildManifest& OutManifest)
+{
+	FString JsonString;
+	if (!FFileHelper::LoadFileToString(JsonString, *GetManifestPath(ModName)))
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> JsonObject;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+	if (!FJsonSerializer::Deserialize(Reader, JsonObject) || !JsonObject.IsValid())
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Build manifest of %s is corrupted, doing a full cook"), *ModName);
+		return false;
+	}
+
+	if (JsonObject->GetIntegerField("version") != ManifestVersion)
+	{
+		return false;
+	}
+
+	OutManifest = FModBuildManifest();
+	OutManifest.ModPath = FString("/Game") / "Mods" / ModName;
+
+	const TSharedPtr<FJsonObject>* PackagesObject;
+	if (!JsonObject->TryGetObjectField("packages", PackagesObject))
+	{
+		return false;
+	}
+
+	for (const auto& Pair : (*PackagesObject)->Values)
+	{
+		const TSharedPtr<FJsonObject>* PackageObject;
+		if (!Pair.Value->TryGetObject(PackageObject))
+		{
+			continue;
+		}
+
+		FModBuildManifestEntry& Entry = OutManifest.Packages.Add(*Pair.Key);
+		Entry.Hash = (*PackageObject)->GetStringField("hash");
+
+		FString Timestamp;
+		(*PackageObject)->TryGetNumberField("size", Entry.Size);
+		if ((*PackageObject)->TryGetStringField("timestamp", Timestamp))
+		{
+			Entry.Timestamp = FDateTime(FCString::Atoi64(*Timestamp));
+		}
+
+		TArray<FString> Dependencies;
+		(*PackageObject)->TryGetStringArrayField("dependencies", Dependencies);
+		Algo::Transform(Dependencies, Entry.Dependencies, [](const FString& Dependency) { return FName(*Dependency); });
+	}
+
+	return true;
+}
+
+bool FModBuildManifest::Save(const FString& ModName) const
+{
+	const TSharedRef<FJsonObject> PackagesObject = MakeShared<FJsonObject>();
+	for (const auto& Pair : Packages)
+	{
+		TArray<TSharedPtr<FJsonValue>> Dependencies;
+		for (const FName Dependency : Pair.Value.Dependencies)
+		{
+			Dependencies.Add(MakeShared<FJsonValueString>(Dependency.ToString()));
+		}
+
+		const TSharedRef<FJsonObject> PackageObject = MakeShared<FJsonObject>();
+		PackageObject->SetStringField("hash", Pair.Value.Hash);
+		PackageObject->SetNumberField("size", Pair.Value.Size);
+		// Ticks as string, as a number they would lose precision
+		PackageObject->SetStringField("timestamp", LexToString(Pair.Value.Timestamp.GetTicks()));
+		PackageObject->SetArrayField("dependencies", Dependencies);
+		PackagesObject->SetObjectField(Pair.Key.ToString(), PackageObject);
+	}
+
+	const TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
+	JsonObject->SetNumberField("version", ManifestVersion);
+	JsonObject->SetObjectField("packages", PackagesObject);
+
+	FString JsonString;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&JsonString);
+	FJsonSerializer::Serialize(JsonObject, Writer);
+
+	if (!FFileHelper::SaveStringToFile(JsonString, *GetManifestPath(ModName)))
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Failed to save the build manifest of %s"), *ModName);
+		return false;
+	}
+
+	return true;
+}
+
+void FModBuildManifest::Delete(const FString& ModName)
+{
+	IFileManager::Get().Delete(*GetManifestPath(ModName), false, false, true);
+}
+
+TArray<FString> FModBuildManifest::GetDirtyModPackages(const FModBuildManifest& Previous) const
+{
+	TSet<FName> Dirty;
+	for (const auto& Pair : Packages)
+	{
+		const FModBuildManifestEntry* PreviousEntry = Previous.Packages.Find(Pair.Key);
+		if (!PreviousEntry || PreviousEntry->Hash != Pair.Value.Hash || Pair.Value.Hash.IsEmpty())
+		{
+			Dirty.Add(Pair.Key);
+		}
+	}
+
+	for (const auto& Pair : Previous.Packages)
+	{
+		if (!Packages.Contains(Pair.Key))
+		{
+			Dirty.Add(Pair.Key);
+		}
+	}
+
+	// Propagate to referencers until nothing new gets dirty
+	bool bChanged = Dirty.Num() > 0;
+	while (bChanged)
+	{
+		bChanged = false;
+		for (const auto& Pair : Packages)
+		{
+			if (Dirty.Contains(Pair.Key))
+			{
+				continue;
+			}
+
+			for (const FName Dependency : Pair.Value.Dependencies)
+			{
+				if (Dirty.Contains(Dependency))
+				{
+					Dirty.Add(Pair.Key);
+					bChanged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	TArray<FString> DirtyModPackages;
+	for (const FName PackageName : Dirty)
+	{
+		if (Packages.Contains(PackageName) && IsInMod(PackageName, ModPath))
+		{
+			DirtyModPackages.Add(PackageName.ToString());
+		}
+	}
+
+	DirtyModPackages.Sort();
+	return DirtyModPackages;
+}
+
+TArray<FString> FModBuildManifest::GetRemovedModPackages(const FModBuildManifest& Previous) const
+{
+	TArray<FString> Removed;
+	for (const auto& Pair : Previous.Packages)
+	{
+		if (!Packages.Contains(Pair.Key) && IsInMod(Pair.Key, ModPath))
+		{
+			Removed.Add(Pair.Key.ToString());
+		}
+	}
+	return Removed;
+}
+
+bool FModBuildManifest::IsUnchanged(const FModBuildManifest& Previous) const
+{
+	return GetDirtyModPackages(Previous).IsEmpty() && GetRemovedModPackages(Previous).IsEmpty();
+}
@@ -0,0 +1,69 @@
+﻿#include "Build/ModCookOutputParser.h"
+
+#include "Internationalization/Regex.h"
+#include "String/Find.h"
+
+namespace
+{
+	// LogCook: Display: Cooked packages 120 Packages Remain 380 Total 500
+	const FRegexPattern& GetProgressPattern()
+	{
+		static const FRegexPattern Pattern(TEXT("Cooked packages (\\d+) Packages Remain (\\d+) Total (\\d+)"));
+		return Pattern;
+	}
+
+	// [timestamp][frame]LogCategory: Warning: Message
+	const FRegexPattern& GetSeverityPattern()
+	{
+		static const FRegexPattern Pattern(TEXT("^(?:\\[[^\\]]*\\])*\\s*\\w+: (Warning|Error): (.*)$"));
+		return Pattern;
+	}
+
+	const FRegexPattern& GetAssetPathPattern()
+	{
+		static const FRegexPattern Pattern(TEXT("/Game/[^\\s'\",:;()]+"));
+		return Pattern;
+	}
+}
+
+FModParsedOutputLine FModCookOutputParser::Parse(FStringView Line)
+{
+	FModParsedOutputLine Result;
+
+	// Cheap checks first, the regex only runs on the few lines that can match
+	if (UE::String::FindFirst(Line, TEXTVIEW("Cooked packages ")) != INDEX_NONE)
+	{
+		FRegexMatcher Matcher(GetProgressPattern(), FString(Line));
+		if (Matcher.FindNext())
+		{
+			Result.Type = EModOutputLineType::Progress;
+			Result.CookedPackages = FCString::Atoi(*Matcher.GetCaptureGroup(1));
+			Result.TotalPackages = FCString::Atoi(*Matcher.GetCaptureGroup(3));
+		}
+		return Result;
+	}
+
+	if (UE::String::FindFirst(Line, TEXTVIEW(": Warning: ")) == INDEX_NONE &&
+		UE::String::FindFirst(Line, TEXTVIEW(": Error: ")) == INDEX_NONE)
+	{
+		return Result;
+	}
+
+	FRegexMatcher Matcher(GetSeverityPattern(), FString(Line));
+	if (!Matcher.FindNext())
+	{
+		return Result;
+	}
+
+	Result.Type = Matcher.GetCaptureGroup(1) == TEXT("Error") ? EModOutputLineType::Error : EModOutputLineType::Warning;
+	Result.Message = Matcher.GetCaptureGroup(2);
+
+	FRegexMatcher AssetMatcher(GetAssetPathPattern(), Result.Message);
+	if (AssetMatcher.FindNext())
+	{
+		Result.AssetPath = AssetMatcher.GetCaptureGroup(0);
+		Result.AssetPath.RemoveFromEnd(TEXT("."));
+	}
+
+	return Result;
+}
@@ -0,0 +1,333 @@
+﻿#include "Build/ModCookWorker.h"
+
+#include "ModdingEx.h"
+#include "ModdingExSettings.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "Async/Async.h"
+#include "Build/ModBuildJob.h"
+#include "Build/ModCookWorkerProtocol.h"
+#include "Build/ModProcessRunner.h"
+#include "Common/TcpSocketBuilder.h"
+#include "Interfaces/IPv4/IPv4Address.h"
+#include "Misc/ScopeExit.h"
+
+namespace
+{
+	TArray<TSharedPtr<FJsonValue>> ToJsonArray(const TArray<FString>& Values)
+	{
+		TArray<TSharedPtr<FJsonValue>> JsonValues;
+		for (const FString& Value : Values)
+		{
+			JsonValues.Add(MakeShared<FJsonValueString>(Value));
+		}
+		return JsonValues;
+	}
+
+	void DestroySocket(FSocket*& Socket)
+	{
+		if (Socket)
+		{
+			Socket->Close();
+			ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+			Socket = nullptr;
+		}
+	}
+}
+
+FModCookWorker& FModCookWorker::Get()
+{
+	static FModCookWorker Instance;
+	return Instance;
+}
+
+FModCookWorker::FModCookWorker()
+{
+	PackageSavedHandle = UPackage::PackageSavedWithContextEvent.AddRaw(this, &FModCookWorker::OnPackageSaved);
+}
+
+FModCookWorker::~FModCookWorker()
+{
+	// Runs during static destruction after the socket subsystem is gone, everything is torn down in Shutdown
+}
+
+void FModCookWorker::Prewarm()
+{
+	if (bShuttingDown)
+	{
+		return;
+	}
+
+	Async(EAsyncExecution::Thread, [this]
+	{
+		FScopeLock Lock(&WorkerLock);
+		EnsureRunning(nullptr);
+	});
+}
+
+EModCookWorkerResult FModCookWorker::Cook(const FModCookRequest& Request, FModBuildJob* Job)
+{
+	check(!IsInGameThread());
+
+	FScopeLock Lock(&WorkerLock);
+
+	// The worker cooks iteratively, a clean cook has to go through the cook commandlet
+	if (!Request.bIterate)
+	{
+		return EModCookWorkerResult::Unavailable;
+	}
+
+	if (!EnsureRunning(Job))
+	{
+		// No point in falling back to another cook while the editor is closing
+		return bShuttingDown || (Job && Job->IsCancelled()) ? EModCookWorkerResult::Failed : EModCookWorkerResult::Unavailable;
+	}
+
+	SetOutputJob(Job);
+	ON_SCOPE_EXIT
+	{
+		SetOutputJob(nullptr);
+	};
+
+	TArray<FString> ChangedPackages;
+	{
+		FScopeLock SavedLock(&SavedPackagesLock);
+		ChangedPackages = SavedPackages.Array();
+		SavedPackages.Empty();
+	}
+
+	auto RestoreChangedPackages = [this, &ChangedPackages]
+	{
+		FScopeLock SavedLock(&SavedPackagesLock);
+		SavedPackages.Append(ChangedPackages);
+	};
+
+	const int32 JobId = NextJobId++;
+
+	const TSharedRef<FJsonObject> Message = ModCookWorkerProtocol::MakeMessage(ModCookWorkerProtocol::Cook);
+	Message->SetNumberField("id", JobId);
+	Message->SetArrayField("cookDirectories", ToJsonArray(Request.CookDirectories));
+	Message->SetArrayField("packages", ToJsonArray(Request.Packages));
+	Message->SetArrayField("scanPaths", ToJsonArray(Request.ScanPaths));
+	Message->SetBoolField("scoped", Request.bScoped);
+	Message->SetArrayField("changedPackages", ToJsonArray(ChangedPackages));
+
+	if (!ModCookWorkerProtocol::SendMessage(*Connection, Message))
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Failed to send the cook job to the cook worker"));
+		RestoreChangedPackages();
+		StopProcess();
+		return EModCookWorkerResult::Unavailable;
+	}
+
+	bool bCancelSent = false;
+	while (true)
+	{
+		if (bShuttingDown)
+		{
+			UE_LOG(LogModdingEx, Warning, TEXT("Editor is shutting down, stopping the cook worker"));
+			StopProcess();
+			return EModCookWorkerResult::Failed;
+		}
+
+		if (Job && Job->IsCancelled() && !bCancelSent)
+		{
+			ModCookWorkerProtocol::SendMessage(*Connection, ModCookWorkerProtocol::MakeMessage(ModCookWorkerProtocol::Cancel));
+			bCancelSent = true;
+		}
+
+		TSharedPtr<FJsonObject> Reply;
+		bool bConnectionLost = false;
+		if (ModCookWorkerProtocol::ReceiveMessage(*Connection, ReceiveBuffer, Reply, FTimespan::FromMilliseconds(250), bConnectionLost))
+		{
+			if (Reply->GetStringField("type") == ModCookWorkerProtocol::Result && Reply->GetIntegerField("id") == JobId)
+			{
+				const bool bSuccess = Reply->GetBoolField("success");
+				if (!bSuccess)
+				{
+					RestoreChangedPackages();
+				}
+				return bSuccess ? EModCookWorkerResult::Succeeded : EModCookWorkerResult::Failed;
+			}
+			continue;
+		}
+
+		if (bConnectionLost || !Process->IsRunning())
+		{
+			UE_LOG(LogModdingEx, Error, TEXT("Cook worker exited while cooking"));
+			RestoreChangedPackages();
+			StopProcess();
+			return bCancelSent ? EModCookWorkerResult::Failed : EModCookWorkerResult::Unavailable;
+		}
+	}
+}
+
+void FModCookWorker::Shutdown()
+{
+	UPackage::PackageSavedWithContextEvent.Remove(PackageSavedHandle);
+
+	// A cook or startup that is still running sees this within a poll interval, stops the process and releases the lock
+	bShuttingDown = true;
+	WorkerLock.Lock();
+
+	if (Connection && ModCookWorkerProtocol::SendMessage(*Connection, ModCookWorkerProtocol::MakeMessage(ModCookWorkerProtocol::Quit)))
+	{
+		const double Deadline = FPlatformTime::Seconds() + 5.0;
+		while (Process->IsRunning() && FPlatformTime::Seconds() < Deadline)
+		{
+			FPlatformProcess::Sleep(0.1f);
+		}
+	}
+
+	StopProcess();
+	WorkerLock.Unlock();
+}
+
+bool FModCookWorker::EnsureRunning(FModBuildJob* Job)
+{
+	if (bShuttingDown)
+	{
+		StopProcess();
+		return false;
+	}
+
+	if (IsRunning())
+	{
+		return true;
+	}
+
+	// Clean up whatever is left of a worker that died
+	StopProcess();
+
+	ListenSocket = FTcpSocketBuilder(TEXT("ModdingExCookWorkerListener"))
+		.AsReusable()
+		.BoundToAddress(FIPv4Address(127, 0, 0, 1))
+		.BoundToPort(0)
+		.Listening(1);
+
+	if (!ListenSocket)
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to create the cook worker listen socket"));
+		return false;
+	}
+
+	const FString Args = FString::Printf(
+		TEXT("\"%s\" -run=ModCookWorker -%s%d -TargetPlatform=Windows -unversioned -stdout -CrashForUAT -unattended -NoLogTimes -UTF8Output"),
+		*(FPaths::ProjectDir() / FApp::GetProjectName() + TEXT(".uproject")), *ModCookWorkerProtocol::PortSwitch, ListenSocket->GetPortNo());
+	UE_LOG(LogModdingEx, Log, TEXT("Starting cook worker: %s"), *Args);
+
+	SetOutputJob(Job);
+
+	Process = MakeUnique<FModProcessRunner>(FPaths::EngineDir() / "Binaries/Win64/UnrealEditor-Cmd.exe", Args);
+	Process->SetOnStdOut([this](FStringView Line)
+	{
+		FScopeLock Lock(&OutputJobLock);
+		if (OutputJob)
+		{
+			OutputJob->AddOutputLine(FString(Line));
+		}
+		else
+		{
+			UE_LOG(LogModdingEx, Verbose, TEXT("CookWorker: %.*s"), Line.Len(), Line.GetData());
+		}
+	});
+
+	if (!Process->Launch())
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to start the cook worker"));
+		StopProcess();
+		return false;
+	}
+
+	if (Job)
+	{
+		Job->AddOutputLine(TEXT("Starting cook worker, this only happens once per editor session"));
+	}
+
+	const double Deadline = FPlatformTime::Seconds() + GetDefault<UModdingExSettings>()->CookWorkerStartupTimeout;
+	auto ShouldGiveUp = [this, Job, Deadline]
+	{
+		return bShuttingDown || !Process->IsRunning() || (Job && Job->IsCancelled()) || FPlatformTime::Seconds() > Deadline;
+	};
+
+	while (!Connection)
+	{
+		if (ShouldGiveUp())
+		{
+			UE_LOG(LogModdingEx, Warning, TEXT("Cook worker didn't connect"));
+			StopProcess();
+			return false;
+		}
+
+		bool bHasPendingConnection = false;
+		if (ListenSocket->WaitForPendingConnection(bHasPendingConnection, FTimespan::FromMilliseconds(250)) && bHasPendingConnection)
+		{
+			Connection = ListenSocket->Accept(TEXT("ModdingExCookWorker"));
+		}
+	}
+
+	// The worker reports ready once its cook server is initialized
+	while (true)
+	{
+		if (ShouldGiveUp())
+		{
+			UE_LOG(LogModdingEx, Warning, TEXT("Cook worker didn't become ready"));
+			StopProcess();
+			return false;
+		}
+
+		TSharedPtr<FJsonObject> Message;
+		bool bConnectionLost = false;
+		if (ModCookWorkerProtocol::ReceiveMessage(*Connection, ReceiveBuffer, Message, FTimespan::FromMilliseconds(250), bConnectionLost))
+		{
+			if (Message->GetStringField("type") == ModCookWorkerProtocol::Ready)
+			{
+				break;
+			}
+		}
+		else if (bConnectionLost)
+		{
+			UE_LOG(LogModdingEx, Warning, TEXT("Cook worker closed the connection during startup"));
+			StopProcess();
+			return false;
+		}
+	}
+
+	SetOutputJob(nullptr);
+
+	UE_LOG(LogModdingEx, Log, TEXT("Cook worker is ready"));
+	return true;
+}
+
+bool FModCookWorker::IsRunning()
+{
+	return Connection && Process && Process->IsRunning();
+}
+
+void FModCookWorker::StopProcess()
+{
+	DestroySocket(Connection);
+	DestroySocket(ListenSocket);
+	ReceiveBuffer.Reset();
+
+	// Terminates the process if it is still running
+	Process.Reset();
+	SetOutputJob(nullptr);
+}
+
+void FModCookWorker::SetOutputJob(FModBuildJob* Job)
+{
+	FScopeLock Lock(&OutputJobLock);
+	OutputJob = Job;
+}
+
+void FModCookWorker::OnPackageSaved(const FString& PackageFileName, UPackage* Package, FObjectPostSaveContext ObjectSaveContext)
+{
+	if (!Package)
+	{
+		return;
+	}
+
+	FScopeLock Lock(&SavedPackagesLock);
+	SavedPackages.Add(Package->GetName());
+}
@@ -0,0 +1,96 @@
+﻿#include "Build/ModCookWorkerProtocol.h"
+
+#include "Sockets.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+
+namespace ModCookWorkerProtocol
+{
+	bool TryExtractMessage(TArray<uint8>& Buffer, TSharedPtr<FJsonObject>& OutMessage)
+	{
+		while (true)
+		{
+			int32 LineEnd = INDEX_NONE;
+			if (!Buffer.Find('\n', LineEnd))
+			{
+				return false;
+			}
+
+			const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Buffer.GetData()), LineEnd);
+			const FString Line(Converted.Length(), Converted.Get());
+			Buffer.RemoveAt(0, LineEnd + 1, false);
+
+			const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Line);
+			if (FJsonSerializer::Deserialize(Reader, OutMessage) && OutMessage.IsValid())
+			{
+				return true;
+			}
+		}
+	}
+
+	TSharedRef<FJsonObject> MakeMessage(const FString& Type)
+	{
+		TSharedRef<FJsonObject> Message = MakeShared<FJsonObject>();
+		Message->SetStringField("type", Type);
+		return Message;
+	}
+
+	bool SendMessage(FSocket& Socket, const TSharedRef<FJsonObject>& Message)
+	{
+		FString JsonString;
+		const TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer =
+			TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&JsonString);
+		if (!FJsonSerializer::Serialize(Message, Writer))
+		{
+			return false;
+		}
+		JsonString += TEXT("\n");
+
+		const FTCHARToUTF8 Converted(*JsonString);
+		const uint8* Data = reinterpret_cast<const uint8*>(Converted.Get());
+		int32 Remaining = Converted.Length();
+
+		while (Remaining > 0)
+		{
+			int32 BytesSent = 0;
+			if (!Socket.Send(Data, Remaining, BytesSent))
+			{
+				return false;
+			}
+
+			Data += BytesSent;
+			Remaining -= BytesSent;
+		}
+
+		return true;
+	}
+
+	bool ReceiveMessage(FSocket& Socket, TArray<uint8>& Buffer, TSharedPtr<FJsonObject>& OutMessage,
+	                    const FTimespan& WaitTime, bool& bOutConnectionLost)
+	{
+		bOutConnectionLost = false;
+
+		while (!TryExtractMessage(Buffer, OutMessage))
+		{
+			if (!Socket.Wait(ESocketWaitConditions::WaitForRead, WaitTime))
+			{
+				return false;
+			}
+
+			uint8 Chunk[4096];
+			int32 BytesRead = 0;
+
+			// A readable socket without any data means the other side closed the connection
+			if (!Socket.Recv(Chunk, sizeof(Chunk), BytesRead) || BytesRead == 0)
+			{
+				bOutConnectionLost = true;
+				return false;
+			}
+
+			Buffer.Append(Chunk, BytesRead);
+		}
+
+		return true;
+	}
+}
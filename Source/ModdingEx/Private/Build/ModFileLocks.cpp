@@ -0,0 +1,165 @@
+﻿#include "Build/ModFileLocks.h"
+
+#include "ModdingEx.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <Windows.h>
+#include <RestartManager.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+namespace
+{
+	/** The fallback process scan is reused for this long */
+	constexpr double ProcessCacheLifetime = 10.0;
+
+	/** How long to wait for a terminated process to release its handles */
+	constexpr double TerminateTimeout = 5.0;
+}
+
+bool FModFileLocks::IsFileLocked(const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Filename))
+	{
+		return false;
+	}
+
+	// Opening for writing without sharing fails as long as anyone else has the file open
+	IFileHandle* Handle = PlatformFile.OpenWrite(*Filename, true, false);
+	if (!Handle)
+	{
+		return true;
+	}
+
+	delete Handle;
+	return false;
+}
+
+TArray<FModLockingProcess> FModFileLocks::GetLockingProcesses(const FString& Filename, const TArray<FString>& CandidateNames)
+{
+	TArray<FModLockingProcess> Processes;
+	if (QueryRestartManager(Filename, Processes))
+	{
+		return Processes;
+	}
+
+	return GetRunningProcesses(CandidateNames);
+}
+
+bool FModFileLocks::TerminateProcess(const FModLockingProcess& Process)
+{
+	FProcHandle Handle = FPlatformProcess::OpenProcess(Process.ProcessId);
+	if (!Handle.IsValid())
+	{
+		// Already gone
+		return true;
+	}
+
+	// The pid might have been reused since the process list was cached
+	const FString CurrentName = FPaths::GetCleanFilename(FPlatformProcess::GetApplicationName(Process.ProcessId));
+	if (!CurrentName.IsEmpty() && CurrentName != Process.Name)
+	{
+		FPlatformProcess::CloseProc(Handle);
+		return true;
+	}
+
+	UE_LOG(LogModdingEx, Log, TEXT("Killing process: %s (%u)"), *Process.Name, Process.ProcessId);
+	FPlatformProcess::TerminateProc(Handle);
+
+	const double StartTime = FPlatformTime::Seconds();
+	while (FPlatformProcess::IsProcRunning(Handle) && FPlatformTime::Seconds() - StartTime < TerminateTimeout)
+	{
+		FPlatformProcess::Sleep(0.05f);
+	}
+
+	const bool bExited = !FPlatformProcess::IsProcRunning(Handle);
+	FPlatformProcess::CloseProc(Handle);
+
+	FScopeLock Lock(&ProcessCacheLock);
+	CachedProcesses.RemoveAll([&Process](const FModLockingProcess& Cached) { return Cached.ProcessId == Process.ProcessId; });
+
+	return bExited;
+}
+
+bool FModFileLocks::QueryRestartManager(const FString& Filename, TArray<FModLockingProcess>& OutProcesses)
+{
+#if PLATFORM_WINDOWS
+	DWORD Session = 0;
+	WCHAR SessionKey[CCH_RM_SESSION_KEY + 1] = {};
+	if (RmStartSession(&Session, 0, SessionKey) != ERROR_SUCCESS)
+	{
+		return false;
+	}
+
+	const FString FullPath = FPaths::ConvertRelativePathToFull(Filename).Replace(TEXT("/"), TEXT("\\"));
+	LPCWSTR Files[] = { *FullPath };
+
+	bool bSuccess = false;
+	if (RmRegisterResources(Session, 1, Files, 0, nullptr, 0, nullptr) == ERROR_SUCCESS)
+	{
+		UINT NumNeeded = 0;
+		UINT NumProcesses = 0;
+		DWORD Reasons = 0;
+		TArray<RM_PROCESS_INFO> ProcessInfos;
+
+		// The list can grow between the two calls
+		DWORD Result = ERROR_MORE_DATA;
+		for (int32 Attempt = 0; Attempt < 3 && Result == ERROR_MORE_DATA; ++Attempt)
+		{
+			ProcessInfos.SetNumZeroed(NumNeeded);
+			NumProcesses = NumNeeded;
+			Result = RmGetList(Session, &NumNeeded, &NumProcesses, ProcessInfos.GetData(), &Reasons);
+		}
+
+		if (Result == ERROR_SUCCESS)
+		{
+			bSuccess = true;
+			for (UINT Index = 0; Index < NumProcesses; ++Index)
+			{
+				const uint32 ProcessId = ProcessInfos[Index].Process.dwProcessId;
+				if (ProcessId == FPlatformProcess::GetCurrentProcessId())
+				{
+					continue;
+				}
+
+				OutProcesses.Add({ProcessId, FPaths::GetCleanFilename(FPlatformProcess::GetApplicationName(ProcessId))});
+			}
+		}
+	}
+
+	RmEndSession(Session);
+	return bSuccess;
+#else
+	return false;
+#endif
+}
+
+TArray<FModLockingProcess> FModFileLocks::GetRunningProcesses(const TArray<FString>& CandidateNames)
+{
+	FScopeLock Lock(&ProcessCacheLock);
+
+	const double Now = FPlatformTime::Seconds();
+	if (CachedProcessesTime < 0.0 || Now - CachedProcessesTime > ProcessCacheLifetime)
+	{
+		CachedProcesses.Reset();
+
+		FPlatformProcess::FProcEnumerator ProcIter;
+		while (ProcIter.MoveNext())
+		{
+			FPlatformProcess::FProcEnumInfo ProcInfo = ProcIter.GetCurrent();
+			CachedProcesses.Add({ProcInfo.GetPID(), ProcInfo.GetName()});
+		}
+
+		CachedProcessesTime = Now;
+	}
+
+	return CachedProcesses.FilterByPredicate([&CandidateNames](const FModLockingProcess& Process)
+	{
+		return CandidateNames.Contains(Process.Name);
+	});
+}
@@ -0,0 +1,194 @@
+﻿#include "Build/ModPackManifest.h"
+
+#include "ModdingEx.h"
+#include "Async/ParallelFor.h"
+#include "Build/ModBuildManifest.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	constexpr int32 ManifestVersion = 1;
+
+	// Ticks as string, ISO 8601 drops the sub millisecond part of file timestamps and numbers lose it as doubles
+	FString TimestampToString(const FDateTime& Timestamp)
+	{
+		return LexToString(Timestamp.GetTicks());
+	}
+
+	FDateTime TimestampFromString(const FString& String)
+	{
+		return FDateTime(FCString::Atoi64(*String));
+	}
+}
+
+FString FModPackManifest::GetManifestPath(const FString& ModName)
+{
+	return FPaths::ProjectIntermediateDir() / "ModdingEx" / ModName / "PackManifest.json";
+}
+
+FModPackManifest FModPackManifest::Capture(const TArray<FModPakFileEntry>& Files, const FModPakCompressionSettings& Compression,
+                                           const FModPackManifest* Previous)
+{
+	FModPackManifest Manifest;
+	Manifest.CompressionKey = Compression.GetKey();
+
+	TArray<FModPackManifestFile> Entries;
+	Entries.SetNum(Files.Num());
+
+	ParallelFor(Files.Num(), [&Files, &Entries, Previous](int32 Index)
+	{
+		const FFileStatData Stat = IFileManager::Get().GetStatData(*Files[Index].SourcePath);
+
+		FModPackManifestFile& Entry = Entries[Index];
+		Entry.Size = Stat.FileSize;
+		Entry.Timestamp = Stat.ModificationTime;
+
+		const FModPackManifestFile* PreviousEntry = Previous ? Previous->Files.Find(Files[Index].DestPath) : nullptr;
+		if (PreviousEntry && PreviousEntry->Size == Entry.Size && PreviousEntry->Timestamp == Entry.Timestamp)
+		{
+			Entry.Hash = PreviousEntry->Hash;
+		}
+		else
+		{
+			Entry.Hash = FModBuildManifest::HashFile(Files[Index].SourcePath);
+		}
+	});
+
+	for (int32 Index = 0; Index < Files.Num(); ++Index)
+	{
+		Manifest.Files.Add(Files[Index].DestPath, MoveTemp(Entries[Index]));
+	}
+
+	return Manifest;
+}
+
+bool FModPackManifest::Load(const FString& ModName, FModPackManifest& OutManifest)
+{
+	FString JsonString;
+	if (!FFileHelper::LoadFileToString(JsonString, *GetManifestPath(ModName)))
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> JsonObject;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+	if (!FJsonSerializer::Deserialize(Reader, JsonObject) || !JsonObject.IsValid())
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Pack manifest of %s is corrupted, packing again"), *ModName);
+		return false;
+	}
+
+	if (JsonObject->GetIntegerField("version") != ManifestVersion)
+	{
+		return false;
+	}
+
+	OutManifest = FModPackManifest();
+	OutManifest.CompressionKey = JsonObject->GetStringField("compression");
+	OutManifest.PakPath = JsonObject->GetStringField("pak");
+	OutManifest.PakSize = static_cast<int64>(JsonObject->GetNumberField("pakSize"));
+	OutManifest.PakTimestamp = TimestampFromString(JsonObject->GetStringField("pakTimestamp"));
+
+	const TSharedPtr<FJsonObject>* FilesObject;
+	if (!JsonObject->TryGetObjectField("files", FilesObject))
+	{
+		return false;
+	}
+
+	for (const auto& Pair : (*FilesObject)->Values)
+	{
+		const TSharedPtr<FJsonObject>* FileObject;
+		if (!Pair.Value->TryGetObject(FileObject))
+		{
+			continue;
+		}
+
+		FModPackManifestFile& Entry = OutManifest.Files.Add(Pair.Key);
+		Entry.Hash = (*FileObject)->GetStringField("hash");
+		Entry.Size = static_cast<int64>((*FileObject)->GetNumberField("size"));
+		Entry.Timestamp = TimestampFromString((*FileObject)->GetStringField("timestamp"));
+	}
+
+	return true;
+}
+
+bool FModPackManifest::Save(const FString& ModName) const
+{
+	const TSharedRef<FJsonObject> FilesObject = MakeShared<FJsonObject>();
+	for (const auto& Pair : Files)
+	{
+		const TSharedRef<FJsonObject> FileObject = MakeShared<FJsonObject>();
+		FileObject->SetStringField("hash", Pair.Value.Hash);
+		FileObject->SetNumberField("size", Pair.Value.Size);
+		FileObject->SetStringField("timestamp", TimestampToString(Pair.Value.Timestamp));
+		FilesObject->SetObjectField(Pair.Key, FileObject);
+	}
+
+	const TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
+	JsonObject->SetNumberField("version", ManifestVersion);
+	JsonObject->SetStringField("compression", CompressionKey);
+	JsonObject->SetStringField("pak", PakPath);
+	JsonObject->SetNumberField("pakSize", PakSize);
+	JsonObject->SetStringField("pakTimestamp", TimestampToString(PakTimestamp));
+	JsonObject->SetObjectField("files", FilesObject);
+
+	FString JsonString;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&JsonString);
+	FJsonSerializer::Serialize(JsonObject, Writer);
+
+	if (!FFileHelper::SaveStringToFile(JsonString, *GetManifestPath(ModName)))
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Failed to save the pack manifest of %s"), *ModName);
+		return false;
+	}
+
+	return true;
+}
+
+void FModPackManifest::Delete(const FString& ModName)
+{
+	IFileManager::Get().Delete(*GetManifestPath(ModName), false, false, true);
+}
+
+bool FModPackManifest::HasSameContent(const FModPackManifest& Other) const
+{
+	if (CompressionKey != Other.CompressionKey || Files.Num() != Other.Files.Num())
+	{
+		return false;
+	}
+
+	for (const auto& Pair : Files)
+	{
+		const FModPackManifestFile* OtherEntry = Other.Files.Find(Pair.Key);
+		if (!OtherEntry || Pair.Value.Hash.IsEmpty() || OtherEntry->Hash != Pair.Value.Hash)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FModPackManifest::SetPak(const FString& InPakPath)
+{
+	const FFileStatData Stat = IFileManager::Get().GetStatData(*InPakPath);
+
+	PakPath = FPaths::ConvertRelativePathToFull(InPakPath);
+	PakSize = Stat.bIsValid ? Stat.FileSize : -1;
+	PakTimestamp = Stat.ModificationTime;
+}
+
+bool FModPackManifest::IsPakUpToDate(const FString& InPakPath) const
+{
+	if (PakSize < 0 || !FPaths::IsSamePath(PakPath, FPaths::ConvertRelativePathToFull(InPakPath)))
+	{
+		return false;
+	}
+
+	const FFileStatData Stat = IFileManager::Get().GetStatData(*InPakPath);
+	return Stat.bIsValid && Stat.FileSize == PakSize && Stat.ModificationTime == PakTimestamp;
+}
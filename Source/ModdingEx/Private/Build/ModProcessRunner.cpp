@@ -0,0 +1,431 @@
+﻿#include "Build/ModProcessRunner.h"
+
+#include "ModdingEx.h"
+#include "Async/Async.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ScopeExit.h"
+
+#include <atomic>
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <Windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#elif PLATFORM_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	/** How long to wait for the output after the process exited, a grandchild can keep the pipe open */
+	constexpr double OutputDrainTimeout = 2.0;
+
+	constexpr uint32 WaitIntervalMs = 50;
+
+#if PLATFORM_WINDOWS
+	/** Neither end is inheritable, otherwise every process started while the pipe is open would keep the write end alive */
+	bool CreatePrivatePipe(void*& OutReadPipe, void*& OutWritePipe)
+	{
+		HANDLE ReadPipe = nullptr;
+		HANDLE WritePipe = nullptr;
+		if (!::CreatePipe(&ReadPipe, &WritePipe, nullptr, 0))
+		{
+			return false;
+		}
+
+		OutReadPipe = ReadPipe;
+		OutWritePipe = WritePipe;
+		return true;
+	}
+
+	/**
+	 * Starts the process hidden with the pipes as its stdout and stderr.
+	 * The child only inherits these two handles, so packs that run side by side don't hold each other's pipes open.
+	 */
+	FProcHandle CreateProcWithPipes(const FString& Executable, const FString& Params, HANDLE StdOut, HANDLE StdErr)
+	{
+		TArray<HANDLE, TInlineAllocator<2>> Handles;
+		Handles.Add(StdOut);
+		Handles.AddUnique(StdErr);
+
+		// Handles in the list have to be inheritable, the list keeps anything else from being inherited
+		for (HANDLE Handle : Handles)
+		{
+			::SetHandleInformation(Handle, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+		}
+
+		SIZE_T AttributeListSize = 0;
+		::InitializeProcThreadAttributeList(nullptr, 1, 0, &AttributeListSize);
+
+		TArray<uint8> AttributeListBuffer;
+		AttributeListBuffer.SetNumUninitialized(AttributeListSize);
+		const LPPROC_THREAD_ATTRIBUTE_LIST AttributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(AttributeListBuffer.GetData());
+		if (!::InitializeProcThreadAttributeList(AttributeList, 1, 0, &AttributeListSize))
+		{
+			return FProcHandle();
+		}
+
+		ON_SCOPE_EXIT
+		{
+			::DeleteProcThreadAttributeList(AttributeList);
+		};
+
+		if (!::UpdateProcThreadAttribute(AttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, Handles.GetData(), Handles.Num() * sizeof(HANDLE),
+		                                 nullptr, nullptr))
+		{
+			return FProcHandle();
+		}
+
+		STARTUPINFOEXW StartupInfo = {};
+		StartupInfo.StartupInfo.cb = sizeof(StartupInfo);
+		StartupInfo.StartupInfo.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
+		StartupInfo.StartupInfo.wShowWindow = SW_HIDE;
+		StartupInfo.StartupInfo.hStdOutput = StdOut;
+		StartupInfo.StartupInfo.hStdError = StdErr;
+		StartupInfo.lpAttributeList = AttributeList;
+
+		// CreateProcessW may write to the command line
+		FString CommandLine = FString::Printf(TEXT("\"%s\" %s"), *Executable, *Params);
+
+		PROCESS_INFORMATION ProcInfo = {};
+		if (!::CreateProcessW(nullptr, CommandLine.GetCharArray().GetData(), nullptr, nullptr, true,
+		                      NORMAL_PRIORITY_CLASS | CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT, nullptr, nullptr,
+		                      &StartupInfo.StartupInfo, &ProcInfo))
+		{
+			UE_LOG(LogModdingEx, Verbose, TEXT("CreateProcessW failed with %u"), ::GetLastError());
+			return FProcHandle();
+		}
+
+		::CloseHandle(ProcInfo.hThread);
+		return FProcHandle(ProcInfo.hProcess);
+	}
+#elif PLATFORM_UNIX
+	/**
+	 * The engine opens the read end non-blocking, the reader thread blocks on it instead of polling.
+	 * Neither end is inherited by processes started later, the child gets its own copy of the write end as stdout.
+	 */
+	void PreparePipe(void* ReadPipe, void* WritePipe)
+	{
+		const int ReadFd = static_cast<FPipeHandle*>(ReadPipe)->GetHandle();
+		::fcntl(ReadFd, F_SETFL, ::fcntl(ReadFd, F_GETFL) & ~O_NONBLOCK);
+		::fcntl(ReadFd, F_SETFD, FD_CLOEXEC);
+		::fcntl(static_cast<FPipeHandle*>(WritePipe)->GetHandle(), F_SETFD, FD_CLOEXEC);
+	}
+#endif
+}
+
+struct FModProcessPipeReader
+{
+	void* ReadPipe = nullptr;
+
+	FCriticalSection OnLineLock;
+	FModProcessRunner::FOnOutputLine OnLine;
+	TSharedPtr<FEvent, ESPMode::ThreadSafe> DrainedEvent;
+
+	std::atomic<bool> bDrained = false;
+
+	/** Set once the process exited, only used on platforms where reading the pipe can't block */
+	std::atomic<bool> bProcessExited = false;
+
+	~FModProcessPipeReader()
+	{
+		FPlatformProcess::ClosePipe(ReadPipe, nullptr);
+	}
+
+	void Run()
+	{
+		TArray<uint8> Pending;
+		TArray<uint8> Chunk;
+
+		while (Read(Chunk))
+		{
+			Pending.Append(Chunk);
+			EmitLines(Pending, false);
+		}
+
+		EmitLines(Pending, true);
+
+		bDrained = true;
+		DrainedEvent->Trigger();
+	}
+
+	/** Stops calling back into the runner's owner, a reader can outlive the runner if a grandchild keeps the pipe open */
+	void Detach()
+	{
+		bProcessExited = true;
+
+		FScopeLock Lock(&OnLineLock);
+		OnLine = nullptr;
+	}
+
+private:
+	/** Returns false once the pipe is closed and everything has been read */
+	bool Read(TArray<uint8>& OutChunk)
+	{
+#if PLATFORM_WINDOWS
+		OutChunk.SetNumUninitialized(16 * 1024, false);
+
+		DWORD BytesRead = 0;
+		if (!::ReadFile(ReadPipe, OutChunk.GetData(), OutChunk.Num(), &BytesRead, nullptr) || BytesRead == 0)
+		{
+			// ERROR_BROKEN_PIPE, all write ends are closed
+			return false;
+		}
+
+		OutChunk.SetNum(BytesRead, false);
+		return true;
+#elif PLATFORM_UNIX
+		OutChunk.SetNumUninitialized(16 * 1024, false);
+
+		while (true)
+		{
+			const ssize_t BytesRead = ::read(static_cast<FPipeHandle*>(ReadPipe)->GetHandle(), OutChunk.GetData(), OutChunk.Num());
+			if (BytesRead < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			// 0 once all write ends are closed
+			if (BytesRead <= 0)
+			{
+				return false;
+			}
+
+			OutChunk.SetNum(BytesRead, false);
+			return true;
+		}
+#else
+		while (true)
+		{
+			// Checked before reading so the last read after the exit drains the pipe
+			const bool bExited = bProcessExited;
+			if (FPlatformProcess::ReadPipeToArray(ReadPipe, OutChunk) && OutChunk.Num() > 0)
+			{
+				return true;
+			}
+
+			if (bExited)
+			{
+				return false;
+			}
+
+			FPlatformProcess::Sleep(0.01f);
+		}
+#endif
+	}
+
+	void EmitLines(TArray<uint8>& Buffer, bool bFlush)
+	{
+		int32 LineStart = 0;
+		for (int32 Index = 0; Index < Buffer.Num(); ++Index)
+		{
+			if (Buffer[Index] == '\n')
+			{
+				EmitLine(Buffer.GetData() + LineStart, Index - LineStart);
+				LineStart = Index + 1;
+			}
+		}
+
+		if (bFlush && LineStart < Buffer.Num())
+		{
+			EmitLine(Buffer.GetData() + LineStart, Buffer.Num() - LineStart);
+			LineStart = Buffer.Num();
+		}
+
+		Buffer.RemoveAt(0, LineStart, false);
+	}
+
+	void EmitLine(const uint8* Data, int32 Length)
+	{
+		if (Length > 0 && Data[Length - 1] == '\r')
+		{
+			--Length;
+		}
+
+		FScopeLock Lock(&OnLineLock);
+		if (OnLine)
+		{
+			const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Data), Length);
+			OnLine(FStringView(Converted.Get(), Converted.Length()));
+		}
+	}
+};
+
+FModProcessRunner::FModProcessRunner(const FString& Executable, const FString& Params) : Executable(Executable), Params(Params)
+{
+}
+
+FModProcessRunner::~FModProcessRunner()
+{
+	if (Process.IsValid())
+	{
+		if (FPlatformProcess::IsProcRunning(Process))
+		{
+			FPlatformProcess::TerminateProc(Process, true);
+		}
+		FPlatformProcess::CloseProc(Process);
+	}
+
+	// Readers that are still blocked own their pipe and finish on their own once it is closed
+	for (const TSharedPtr<FModProcessPipeReader, ESPMode::ThreadSafe>& Reader : {StdOutReader, StdErrReader})
+	{
+		if (Reader)
+		{
+			Reader->Detach();
+		}
+	}
+}
+
+bool FModProcessRunner::Launch()
+{
+	check(!Process.IsValid());
+
+	void* StdOutRead = nullptr;
+	void* StdOutWrite = nullptr;
+	void* StdErrRead = nullptr;
+	void* StdErrWrite = nullptr;
+
+#if PLATFORM_WINDOWS
+	if (!CreatePrivatePipe(StdOutRead, StdOutWrite) || (OnStdErr && !CreatePrivatePipe(StdErrRead, StdErrWrite)))
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to create the output pipes for %s"), *Executable);
+		FPlatformProcess::ClosePipe(StdOutRead, StdOutWrite);
+		return false;
+	}
+
+	Process = CreateProcWithPipes(Executable, Params, StdOutWrite, OnStdErr ? StdErrWrite : StdOutWrite);
+#else
+	FPlatformProcess::CreatePipe(StdOutRead, StdOutWrite);
+	if (OnStdErr)
+	{
+		FPlatformProcess::CreatePipe(StdErrRead, StdErrWrite);
+	}
+
+#if PLATFORM_UNIX
+	PreparePipe(StdOutRead, StdOutWrite);
+	if (OnStdErr)
+	{
+		PreparePipe(StdErrRead, StdErrWrite);
+	}
+#endif
+
+	Process = FPlatformProcess::CreateProc(*Executable, *Params, false, true, true, nullptr, -1, nullptr,
+	                                       StdOutWrite, nullptr, OnStdErr ? StdErrWrite : StdOutWrite);
+#endif
+
+	// The child has its own copies, closing ours makes the reads fail once the child is gone
+	FPlatformProcess::ClosePipe(nullptr, StdOutWrite);
+	FPlatformProcess::ClosePipe(nullptr, StdErrWrite);
+
+	if (!Process.IsValid())
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to start %s"), *Executable);
+		FPlatformProcess::ClosePipe(StdOutRead, nullptr);
+		FPlatformProcess::ClosePipe(StdErrRead, nullptr);
+		return false;
+	}
+
+	OutputDrainedEvent = MakeShareable(FPlatformProcess::GetSynchEventFromPool(false), [](FEvent* Event)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(Event);
+	});
+
+	auto StartReader = [this](void* ReadPipe, FOnOutputLine OnLine)
+	{
+		TSharedRef<FModProcessPipeReader, ESPMode::ThreadSafe> Reader = MakeShared<FModProcessPipeReader, ESPMode::ThreadSafe>();
+		Reader->ReadPipe = ReadPipe;
+		Reader->OnLine = MoveTemp(OnLine);
+		Reader->DrainedEvent = OutputDrainedEvent;
+
+		Async(EAsyncExecution::Thread, [Reader]
+		{
+			Reader->Run();
+		});
+
+		return Reader;
+	};
+
+	StdOutReader = StartReader(StdOutRead, OnStdOut);
+	if (StdErrRead)
+	{
+		StdErrReader = StartReader(StdErrRead, OnStdErr);
+	}
+
+	return true;
+}
+
+bool FModProcessRunner::IsRunning()
+{
+	return Process.IsValid() && FPlatformProcess::IsProcRunning(Process);
+}
+
+int32 FModProcessRunner::Wait(TFunctionRef<bool()> ShouldCancel)
+{
+	if (!Process.IsValid())
+	{
+		return -1;
+	}
+
+	double ExitTime = 0.0;
+	while (true)
+	{
+		if (!bTerminated && ShouldCancel())
+		{
+			UE_LOG(LogModdingEx, Warning, TEXT("Terminating %s"), *Executable);
+			Terminate();
+		}
+
+		if (!FPlatformProcess::IsProcRunning(Process))
+		{
+			if (ExitTime == 0.0)
+			{
+				ExitTime = FPlatformTime::Seconds();
+				for (const TSharedPtr<FModProcessPipeReader, ESPMode::ThreadSafe>& Reader : {StdOutReader, StdErrReader})
+				{
+					if (Reader)
+					{
+						Reader->bProcessExited = true;
+					}
+				}
+			}
+
+			if (IsOutputDrained())
+			{
+				break;
+			}
+
+			if (FPlatformTime::Seconds() - ExitTime > OutputDrainTimeout)
+			{
+				UE_LOG(LogModdingEx, Verbose, TEXT("%s exited but its output pipe is still open"), *Executable);
+				break;
+			}
+		}
+
+		// Wakes up right away once the output is drained, which usually happens when the process exits
+		OutputDrainedEvent->Wait(WaitIntervalMs);
+	}
+
+	int32 ReturnCode = -1;
+	if (!bTerminated)
+	{
+		FPlatformProcess::GetProcReturnCode(Process, &ReturnCode);
+	}
+
+	return ReturnCode;
+}
+
+void FModProcessRunner::Terminate()
+{
+	if (IsRunning())
+	{
+		FPlatformProcess::TerminateProc(Process, true);
+	}
+	bTerminated = true;
+}
+
+bool FModProcessRunner::IsOutputDrained() const
+{
+	return (!StdOutReader || StdOutReader->bDrained) && (!StdErrReader || StdErrReader->bDrained);
+}
@@ -0,0 +1,189 @@
+﻿#include "Commandlets/ModCookWorkerCommandlet.h"
+
+#include "ModdingEx.h"
+#include "PackageTools.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Build/ModCookWorkerProtocol.h"
+#include "Containers/Ticker.h"
+#include "CookOnTheSide/CookOnTheFlyServer.h"
+#include "Interfaces/IPv4/IPv4Address.h"
+#include "Interfaces/ITargetPlatform.h"
+#include "Interfaces/ITargetPlatformManagerModule.h"
+
+namespace
+{
+	TArray<FString> GetStringArray(const FJsonObject& Object, const FString& FieldName)
+	{
+		TArray<FString> Values;
+		Object.TryGetStringArrayField(FieldName, Values);
+		return Values;
+	}
+}
+
+UModCookWorkerCommandlet::UModCookWorkerCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UModCookWorkerCommandlet::Main(const FString& Params)
+{
+	int32 Port = 0;
+	if (!FParse::Value(*Params, *ModCookWorkerProtocol::PortSwitch, Port))
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Missing -%s, the cook worker is started by the editor"), *ModCookWorkerProtocol::PortSwitch);
+		return 1;
+	}
+
+	ITargetPlatform* TargetPlatform = GetTargetPlatformManagerRef().FindTargetPlatform(TEXT("Windows"));
+	if (!TargetPlatform)
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Windows target platform not found"));
+		return 1;
+	}
+
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	const TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+	Address->SetIp(FIPv4Address(127, 0, 0, 1).Value);
+	Address->SetPort(Port);
+
+	FSocket* Socket = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("ModdingExCookWorker"), false);
+	if (!Socket || !Socket->Connect(*Address))
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to connect to the editor on port %d"), Port);
+		if (Socket)
+		{
+			SocketSubsystem->DestroySocket(Socket);
+		}
+		return 1;
+	}
+
+	// CookByTheBookFromTheEditor is the only mode that supports starting multiple cook sessions in one process.
+	// Iterative keeps packages that were cooked by earlier jobs instead of wiping the sandbox every session.
+	UCookOnTheFlyServer* CookServer = NewObject<UCookOnTheFlyServer>();
+	CookServer->AddToRoot();
+	CookServer->Initialize(ECookMode::CookByTheBookFromTheEditor,
+	                       ECookInitializationFlags::Unversioned | ECookInitializationFlags::Iterative);
+
+	ModCookWorkerProtocol::SendMessage(*Socket, ModCookWorkerProtocol::MakeMessage(ModCookWorkerProtocol::Ready));
+	UE_LOG(LogModdingEx, Display, TEXT("Cook worker ready"));
+
+	TArray<uint8> ReceiveBuffer;
+	while (!IsEngineExitRequested())
+	{
+		TSharedPtr<FJsonObject> Message;
+		bool bConnectionLost = false;
+		if (!ModCookWorkerProtocol::ReceiveMessage(*Socket, ReceiveBuffer, Message, FTimespan::FromSeconds(1), bConnectionLost))
+		{
+			if (bConnectionLost)
+			{
+				UE_LOG(LogModdingEx, Display, TEXT("Editor closed the connection, shutting down"));
+				break;
+			}
+			continue;
+		}
+
+		const FString Type = Message->GetStringField("type");
+		if (Type == ModCookWorkerProtocol::Quit)
+		{
+			break;
+		}
+
+		if (Type != ModCookWorkerProtocol::Cook)
+		{
+			continue;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		const bool bCompleted = CookJob(*CookServer, *TargetPlatform, *Message, *Socket, ReceiveBuffer);
+		UE_LOG(LogModdingEx, Display, TEXT("Cook job %s in %.1f seconds"), bCompleted ? TEXT("finished") : TEXT("cancelled"),
+		       FPlatformTime::Seconds() - StartTime);
+
+		const TSharedRef<FJsonObject> Result = ModCookWorkerProtocol::MakeMessage(ModCookWorkerProtocol::Result);
+		Result->SetNumberField("id", Message->GetIntegerField("id"));
+		Result->SetBoolField("success", bCompleted);
+		ModCookWorkerProtocol::SendMessage(*Socket, Result);
+	}
+
+	CookServer->RemoveFromRoot();
+
+	Socket->Close();
+	SocketSubsystem->DestroySocket(Socket);
+
+	return 0;
+}
+
+bool UModCookWorkerCommandlet::CookJob(UCookOnTheFlyServer& CookServer, ITargetPlatform& TargetPlatform, const FJsonObject& Job,
+                                       FSocket& Socket, TArray<uint8>& ReceiveBuffer)
+{
+	// Packages saved in the editor since the last job are stale in this process
+	TArray<UPackage*> StalePackages;
+	for (const FString& PackageName : GetStringArray(Job, "changedPackages"))
+	{
+		if (UPackage* Package = FindPackage(nullptr, *PackageName))
+		{
+			StalePackages.Add(Package);
+		}
+	}
+
+	if (StalePackages.Num() > 0)
+	{
+		UE_LOG(LogModdingEx, Display, TEXT("Unloading %d changed packages"), StalePackages.Num());
+		UPackageTools::UnloadPackages(StalePackages);
+	}
+
+	const TArray<FString> ScanPaths = GetStringArray(Job, "scanPaths");
+	if (ScanPaths.Num() > 0)
+	{
+		IAssetRegistry::GetChecked().ScanPathsSynchronous(ScanPaths, true);
+	}
+
+	UCookOnTheFlyServer::FCookByTheBookStartupOptions StartupOptions;
+	StartupOptions.TargetPlatforms.Add(&TargetPlatform);
+	StartupOptions.CookMaps = GetStringArray(Job, "packages");
+	StartupOptions.CookDirectories = GetStringArray(Job, "cookDirectories");
+
+	bool bScoped = false;
+	if (Job.TryGetBoolField("scoped", bScoped) && bScoped)
+	{
+		StartupOptions.CookOptions |= ECookByTheBookOptions::NoAlwaysCookMaps | ECookByTheBookOptions::NoDefaultMaps |
+			ECookByTheBookOptions::NoGameAlwaysCookPackages | ECookByTheBookOptions::NoInputPackages;
+	}
+
+	CookServer.StartCookByTheBook(StartupOptions);
+
+	bool bCancelled = false;
+	while (CookServer.IsInSession())
+	{
+		uint32 CookedPackagesCount = 0;
+		CookServer.TickCookOnTheSide(0.1f, CookedPackagesCount);
+
+		FTSTicker::GetCoreTicker().Tick(FApp::GetDeltaTime());
+		FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+
+		if (bCancelled)
+		{
+			continue;
+		}
+
+		TSharedPtr<FJsonObject> Message;
+		bool bConnectionLost = false;
+		if (ModCookWorkerProtocol::ReceiveMessage(Socket, ReceiveBuffer, Message, FTimespan::Zero(), bConnectionLost))
+		{
+			bCancelled = Message->GetStringField("type") == ModCookWorkerProtocol::Cancel;
+		}
+
+		if (bCancelled || bConnectionLost)
+		{
+			UE_LOG(LogModdingEx, Display, TEXT("Cancelling cook"));
+			CookServer.CancelCookByTheBook();
+			bCancelled = true;
+		}
+	}
+
+	return !bCancelled;
+}
@@ -73,6 +73,7 @@ void FModdingExSettingsCustomization::CustomizeDetails(IDetailLayoutBuilder& Det
 	// Idiotic lazy setting category priorities, I'm so sorry
 	DetailBuilder.EditCategory("General", FText::GetEmpty(), ECategoryPriority::Variable);
 	DetailBuilder.EditCategory("Building", FText::GetEmpty(), ECategoryPriority::Transform);
+	DetailBuilder.EditCategory("Compression", FText::GetEmpty(), ECategoryPriority::Transform);
 	// Mod managers is Important
 	DetailBuilder.EditCategory("Zipping", FText::GetEmpty(), ECategoryPriority::TypeSpecific);
 	// Hash check is Default
@@ -4,55 +4,88 @@
 #include "ISettingsModule.h"
 #include "ModdingEx.h"
 #include "ModdingExSettings.h"
+#include "Notifications.h"
+#include "Algo/Count.h"
+#include "Algo/Find.h"
 #include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Build/ModBuildJob.h"
+#include "Build/ModBuildManifest.h"
+#include "Build/ModCookWorker.h"
+#include "Build/ModFileLocks.h"
+#include "Build/ModPackManifest.h"
+#include "Build/ModProcessRunner.h"
 #include "Framework/Notifications/NotificationManager.h"
 #include "Misc/FileHelper.h"
 #include "Misc/Paths.h"
+#include "HAL/PlatformFileManager.h"
 #include "HAL/PlatformProcess.h"
-#include "Misc/ScopedSlowTask.h"
+#include "Pak/ModPakBlockCache.h"
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
 #include "UObject/UnrealType.h"
 #include "Widgets/Notifications/SNotificationList.h"
+#include "Zip/ZipWriter.h"
 
-// TODO: Make this async
+/** Longer package lists fall back to cooking the whole mod directory to stay well below the command line limit */
+static constexpr int32 MaxCookPackageListLength = 16 * 1024;
 
-bool UModBuilder::ExecGenericCommand(const TCHAR* Command, const TCHAR* Params, int32* OutReturnCode, FString* OutStdOut, FString* OutStdErr)
-{
-	void* OutputReadPipe = nullptr;
-	void* OutputWritePipe = nullptr;
-	FPlatformProcess::CreatePipe(OutputReadPipe, OutputWritePipe);
-	FProcHandle Proc = FPlatformProcess::CreateProc(Command, Params, false, true, true, nullptr, -1, nullptr, OutputWritePipe, nullptr);
+/** Files that are compressed already and are stored in mod zips as they are, besides CompressedMediaExtensions */
+static const TCHAR* ZipStoredExtensions[] = { TEXT("pak"), TEXT("utoc"), TEXT("ucas"), TEXT("zip"), TEXT("7z"), TEXT("png"), TEXT("jpg") };
 
-	if (!Proc.IsValid())
+/** Result of a mod whose pak didn't have to be written again */
+static FModBuildResult MakeUnchangedResult(const FModBuildTarget& Target, bool bIsSameContentError)
+{
+	if (bIsSameContentError)
 	{
-		FPlatformProcess::ClosePipe(OutputReadPipe, OutputWritePipe);
-		return false;
+		UE_LOG(LogModdingEx, Error, TEXT("Output file is the same as the input file. You didn't change the content."));
+		FModBuildResult Result = FModBuildResult::Failure(Target.ModName, FText::FromString(
+			"Output file is the same as the input file. You didn't change the content."));
+		Result.bContentUnchanged = true;
+		return Result;
 	}
 
-	FString NewLine;
-	FPlatformProcess::Sleep(0.01);
+	FModBuildResult Result = FModBuildResult::Success(Target.ModName, Target.OutputPath);
+	Result.bContentUnchanged = true;
+	return Result;
+}
 
-	while (FPlatformProcess::IsProcRunning(Proc))
+bool UModBuilder::ExecGenericCommand(const TCHAR* Command, const TCHAR* Params, int32* OutReturnCode, FString* OutStdOut, FString* OutStdErr, FModBuildJob* Job)
+{
+	// The callbacks run on the reader threads
+	FCriticalSection OutputLock;
+	auto ForwardLine = [Job, &OutputLock](FStringView Line, FString* Output)
 	{
-		NewLine = FPlatformProcess::ReadPipe(OutputReadPipe);
-		if (NewLine.Len() > 0)
+		if (Job)
+		{
+			Job->AddOutputLine(FString(Line));
+		}
+		else
 		{
-			UE_LOG(LogModdingEx, Log, TEXT("COOK: %s"), *NewLine);
-			NewLine.Empty();
+			UE_LOG(LogModdingEx, Log, TEXT("COOK: %.*s"), Line.Len(), Line.GetData());
 		}
 
-		FPlatformProcess::Sleep(0.25f);
+		if (Output)
+		{
+			FScopeLock Lock(&OutputLock);
+			Output->Append(Line);
+			Output->AppendChar(TEXT('\n'));
+		}
+	};
+
+	FModProcessRunner Runner(Command, Params);
+	Runner.SetOnStdOut([&ForwardLine, OutStdOut](FStringView Line) { ForwardLine(Line, OutStdOut); });
+	if (OutStdErr)
+	{
+		Runner.SetOnStdErr([&ForwardLine, OutStdErr](FStringView Line) { ForwardLine(Line, OutStdErr); });
+	}
+
+	if (!Runner.Launch())
+	{
+		return false;
 	}
 
-	int32 RC;
-	FPlatformProcess::GetProcReturnCode(Proc, &RC);
-	// if (OutStdOut)
-	// {
-	// 	*OutStdOut = FPlatformProcess::ReadPipe(OutputReadPipe);
-	// }
-	FPlatformProcess::ClosePipe(OutputReadPipe, OutputWritePipe);
-	FPlatformProcess::CloseProc(Proc);
+	const int32 RC = Runner.Wait([Job] { return Job && Job->IsCancelled(); });
 	if (OutReturnCode)
 	{
 		*OutReturnCode = RC;
@@ -61,98 +94,235 @@ bool UModBuilder::ExecGenericCommand(const TCHAR* Command, const TCHAR* Params,
 	return RC == 0;
 }
 
-FString UModBuilder::CreateFilesTxt(const FString& RootDir, const FString& TrackingDir)
+FString UModBuilder::CreateFilesTxt(const FString& RootDir, const FString& TrackingDir, bool bQuiet)
 {
-	const FString Directory = FPaths::ConvertRelativePathToFull(FPaths::Combine(RootDir, TrackingDir));
-
-	FString FileContents;
+	return WriteFilesTxt(GetCookedFiles(RootDir, TrackingDir), FModPakCompressionSettings(), bQuiet);
+}
 
+FString UModBuilder::WriteFilesTxt(const TArray<FModPakFileEntry>& Files, const FModPakCompressionSettings& Compression, bool bQuiet)
+{
 	const FString& TmpFilePath = FPaths::CreateTempFilename(FPlatformProcess::UserTempDir(), TEXT("files"), TEXT(".txt"));
 
-	IFileManager& FileManager = IFileManager::Get();
-	TArray<FString> Files;
+	const TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TmpFilePath));
+	if (!Writer)
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to create FilesTxt at: %s"), *TmpFilePath);
+		return FString();
+	}
 
-	FileManager.FindFilesRecursive(Files, *Directory, TEXT("*.*"), true, false);
+	// Lines are collected in a fixed buffer and written as UTF-8 whenever it fills up
+	constexpr int32 FlushSize = 64 * 1024;
+	TUtf8StringBuilder<FlushSize + 1024> Buffer;
 
-	for (const FString& FileName : Files)
+	auto Flush = [&Writer, &Buffer]
 	{
-		FString RelPath = FileName;
-		FPaths::MakePathRelativeTo(RelPath, *RootDir);
+		Writer->Serialize(Buffer.GetData(), Buffer.Len());
+		Buffer.Reset();
+	};
+
+	for (const FModPakFileEntry& File : Files)
+	{
+		const bool bCompress = Compression.Format != NAME_None && !Compression.UncompressedExtensions.Contains(FPaths::GetExtension(File.SourcePath));
+
+		Buffer << '"' << File.SourcePath << "\" \"../../../" << File.DestPath << '"';
+		if (bCompress)
+		{
+			Buffer << " -compress";
+		}
+		Buffer << '\n';
+
+		if (!bQuiet)
+		{
+			UE_LOG(LogModdingEx, Log, TEXT("Entry: %s -> %s"), *File.SourcePath, *File.DestPath);
+		}
 
-		auto str = FString::Printf(TEXT("\"%s\" \"../../../%s\" -compress\n"), *FileName, *RelPath);
-		UE_LOG(LogModdingEx, Log, TEXT("Entry: %s"), *str);
+		if (Buffer.Len() >= FlushSize)
+		{
+			Flush();
+		}
+	}
+
+	Flush();
 
-		FileContents += str;
+	if (!Writer->Close())
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to create FilesTxt at: %s"), *TmpFilePath);
+		return FString();
 	}
 
-	if (FFileHelper::SaveStringToFile(FileContents, *TmpFilePath))
+	UE_LOG(LogModdingEx, Log, TEXT("FilesTxt with %d entries created successfully at: %s"), Files.Num(), *TmpFilePath);
+	return TmpFilePath;
+}
+
+TArray<FModPakFileEntry> UModBuilder::GetCookedFiles(const FString& RootDir, const FString& TrackingDir)
+{
+	FString FullRootDir = FPaths::ConvertRelativePathToFull(RootDir);
+	FPaths::NormalizeDirectoryName(FullRootDir);
+	const FString Directory = FullRootDir / TrackingDir;
+
+	// Paths inside the pak start at the last folder of the root dir, e.g. Pal/Content/Mods/...
+	const FString DestPrefix = FPaths::GetCleanFilename(FullRootDir);
+
+	// Split the walk at the top level so the subdirectories can be walked in parallel
+	TArray<FString> Directories;
+	TArray<TArray<FString>> FilesPerDirectory;
+	FilesPerDirectory.AddDefaulted();
+
+	IFileManager::Get().IterateDirectory(*Directory, [&Directories, &FilesPerDirectory](const TCHAR* Path, bool bIsDirectory)
 	{
-		UE_LOG(LogModdingEx, Log, TEXT("FilesTxt created successfully at: %s"), *TmpFilePath);
-		return TmpFilePath;
+		if (bIsDirectory)
+		{
+			Directories.Add(Path);
+		}
+		else
+		{
+			FilesPerDirectory[0].Add(Path);
+		}
+		return true;
+	});
+
+	FilesPerDirectory.SetNum(Directories.Num() + 1);
+	ParallelFor(Directories.Num(), [&Directories, &FilesPerDirectory](int32 Index)
+	{
+		IFileManager::Get().FindFilesRecursive(FilesPerDirectory[Index + 1], *Directories[Index], TEXT("*.*"), true, false);
+	}, EParallelForFlags::Unbalanced);
+
+	TArray<FModPakFileEntry> Entries;
+	for (const TArray<FString>& Files : FilesPerDirectory)
+	{
+		for (const FString& FileName : Files)
+		{
+			// Every file is below the root dir, so the relative path is just the rest of the path
+			Entries.Add({FileName, DestPrefix / FileName.RightChop(FullRootDir.Len() + 1)});
+		}
 	}
 
-	UE_LOG(LogModdingEx, Log, TEXT("Failed to create FilesTxt at: %s"), *TmpFilePath);
-	return FString();
+	// Keeps the order in the pak stable between builds
+	Entries.Sort([](const FModPakFileEntry& A, const FModPakFileEntry& B) { return A.DestPath < B.DestPath; });
+	return Entries;
 }
 
 bool UModBuilder::Cook()
+{
+	return CookInternal(FModCookRequest(), nullptr);
+}
+
+bool UModBuilder::CookInternal(const FModCookRequest& Request, FModBuildJob* Job)
 {	
 	FString Args = FString::Printf(
 		TEXT("\"%s\" -run=Cook -TargetPlatform=Windows -unversioned -stdout -CrashForUAT -unattended -NoLogTimes -UTF8Output"),
 		*(FPaths::ProjectDir() / FApp::GetProjectName() + TEXT(".uproject")));
+
+	if (Request.Packages.Num() > 0)
+	{
+		Args += FString::Printf(TEXT(" -Package=%s"), *FString::Join(Request.Packages, TEXT("+")));
+	}
+
+	// The directories are only passed to this cook, the project settings stay untouched
+	for (const FString& Directory : Request.CookDirectories)
+	{
+		Args += FString::Printf(TEXT(" -CookDir=\"%s\""), *Directory);
+	}
+
+	if (Request.bScoped)
+	{
+		Args += TEXT(" -NoAlwaysCookMaps -NoDefaultMaps -NoGameAlwaysCook -NoInputPackages");
+	}
+
+	if (Request.bIterate)
+	{
+		Args += TEXT(" -iterate");
+	}
+
 	UE_LOG(LogModdingEx, Log, TEXT("Args: %s"), *Args);
 
 	int32 OutReturnCode = 0;
-	FString OutStdOut;
-	FString OutStdErr;
-	if (!FPlatformProcess::ExecProcess(
+	const bool bSuccess = ExecGenericCommand(
 		*(FPaths::EngineDir() / "Binaries/Win64/UnrealEditor-Cmd.exe"),
-		*Args, &OutReturnCode, &OutStdOut, &OutStdErr))
+		*Args, &OutReturnCode, nullptr, nullptr, Job);
+
+	UE_LOG(LogModdingEx, Log, TEXT("Returned with: %d"), OutReturnCode);
+
+	return bSuccess;
+}
+
+bool UModBuilder::CookMods(const FModCookRequest& Request, FModBuildJob& Job)
+{
+	const auto Settings = GetDefault<UModdingExSettings>();
+
+	EModCookWorkerResult WorkerResult = EModCookWorkerResult::Unavailable;
+	if (Settings->bUsePersistentCookWorker)
 	{
-		return false;
+		WorkerResult = FModCookWorker::Get().Cook(Request, &Job);
 	}
 
-	UE_LOG(LogModdingEx, Log, TEXT("Returned with: %d"), OutReturnCode);
+	if (WorkerResult != EModCookWorkerResult::Unavailable || Job.IsCancelled())
+	{
+		return WorkerResult == EModCookWorkerResult::Succeeded;
+	}
 
-	if (OutReturnCode == 0)
+	if (Settings->bUsePersistentCookWorker)
 	{
-		UE_LOG(LogModdingEx, Log, TEXT("%s"), *OutStdOut);
-		return true;
+		UE_LOG(LogModdingEx, Warning, TEXT("Cook worker unavailable, falling back to a regular cook"));
 	}
 
-	UE_LOG(LogModdingEx, Error, TEXT("Err: %s"), *OutStdErr);
-	return false;
+	return CookInternal(Request, &Job);
+}
+
+void UModBuilder::DeleteCookedPackages(const FString& CookedDir, const TArray<FString>& PackageNames)
+{
+	static const TCHAR* CookedExtensions[] = { TEXT(".uasset"), TEXT(".umap"), TEXT(".uexp"), TEXT(".ubulk"), TEXT(".uptnl") };
+
+	for (const FString& PackageName : PackageNames)
+	{
+		FString RelativePath = PackageName;
+		if (!RelativePath.RemoveFromStart(TEXT("/Game/")))
+		{
+			continue;
+		}
+
+		UE_LOG(LogModdingEx, Log, TEXT("Removing cooked files of deleted package %s"), *PackageName);
+		for (const TCHAR* Extension : CookedExtensions)
+		{
+			IFileManager::Get().Delete(*(CookedDir / "Content" / RelativePath + Extension), false, false, true);
+		}
+	}
 }
 
 bool UModBuilder::Pack(const FString& FilesPath, const FString& OutputPath)
+{
+	return PackInternal(FilesPath, OutputPath, FModPakCompressionSettings(), nullptr);
+}
+
+bool UModBuilder::PackInternal(const FString& FilesPath, const FString& OutputPath, const FModPakCompressionSettings& Compression, FModBuildJob* Job)
 {
 	FString Args = FString::Printf(
-		TEXT(
-			"\"%s\" -patchpaddingalign=2048 -compressionformats=Oodle -compressmethod=Kraken -compresslevel=5 -platform=Windows -create=\"%s\" --compress"),
+		TEXT("\"%s\" -patchpaddingalign=%lld -platform=Windows -create=\"%s\""),
 		*OutputPath,
+		FModPakWriter::PatchPaddingAlign,
 		*FilesPath);
-	UE_LOG(LogModdingEx, Log, TEXT("Args: %s"), *Args);
 
-	int32 OutReturnCode = 0;
-	FString OutStdOut;
-	FString OutStdErr;
-	if (!FPlatformProcess::ExecProcess(
-		*FPaths::Combine(FPaths::EngineDir(), TEXT("Binaries/Win64/UnrealPak.exe")),
-		*Args, &OutReturnCode, &OutStdOut, &OutStdErr))
+	if (Compression.Format != NAME_None)
 	{
-		return false;
+		Args += FString::Printf(TEXT(" -compressionformats=%s -compressionblocksize=%d"), *Compression.Format.ToString(), Compression.BlockSize);
 	}
 
-	UE_LOG(LogModdingEx, Log, TEXT("Returned with: %d"), OutReturnCode);
-
-	if (OutReturnCode == 0)
+	if (Compression.Format == NAME_Oodle)
 	{
-		UE_LOG(LogModdingEx, Log, TEXT("%s"), *OutStdOut);
-		return true;
+		const TCHAR* CompressorName = TEXT("Kraken");
+		FOodleDataCompression::ECompressorToString(Compression.Compressor, &CompressorName);
+		Args += FString::Printf(TEXT(" -compressmethod=%s -compresslevel=%d"), CompressorName, static_cast<int32>(Compression.Level));
 	}
+	UE_LOG(LogModdingEx, Log, TEXT("Args: %s"), *Args);
+
+	int32 OutReturnCode = 0;
+	const bool bSuccess = ExecGenericCommand(
+		*FPaths::Combine(FPaths::EngineDir(), TEXT("Binaries/Win64/UnrealPak.exe")),
+		*Args, &OutReturnCode, nullptr, nullptr, Job);
+
+	UE_LOG(LogModdingEx, Log, TEXT("Returned with: %d"), OutReturnCode);
 
-	UE_LOG(LogModdingEx, Error, TEXT("Err: %s"), *OutStdErr);
-	return false;
+	return bSuccess;
 }
 
 bool UModBuilder::GetOutputFolder(bool bIsLogicMod, FString& OutFolder)
@@ -200,24 +370,46 @@ bool UModBuilder::GetOutputFolder(bool bIsLogicMod, FString& OutFolder)
 
 bool UModBuilder::BuildMod(const FString& ModName, bool bIsSameContentError)
 {
+	const TFuture<FModBuildResult> Future = BuildModAsync(ModName, bIsSameContentError);
+
+	// A future that is ready right away means the build couldn't be started
+	return !Future.IsReady() || Future.Get().bSuccess;
+}
+
+bool UModBuilder::PrepareBuild(const TArray<FString>& ModNames, bool bForRelease, TArray<FModBuildTarget>& OutTargets, FText& OutError)
+{
+	check(IsInGameThread());
+
 	const auto Settings = GetDefault<UModdingExSettings>();
 
-	FString OutputDir;
-	if (!GetOutputFolder(true, OutputDir))
+	if (ActiveBuildJob.IsValid())
 	{
-		if (FMessageDialog::Open(EAppMsgType::YesNo, FText::FromString(
-			                         "Game dir is not set or does not exist. Should I take you to the setting?.")) == EAppReturnType::Yes)
+		UE_LOG(LogModdingEx, Error, TEXT("Can't build %s while another build is running"), *FString::Join(ModNames, TEXT(", ")));
+		OutError = FText::FromString("Another mod is currently being built");
+		Notifications::ShowFailNotification(OutError, false);
+		return false;
+	}
+
+	for (const FString& ModName : ModNames)
+	{
+		FModBuildTarget& Target = OutTargets.AddDefaulted_GetRef();
+		Target.ModName = ModName;
+		Target.Compression = GetCompressionSettings(ModName, bForRelease);
+
+		if (!GetOutputPakDirectory(Target.OutputPath, ModName))
 		{
-			FModuleManager::LoadModuleChecked<ISettingsModule>("Settings").ShowViewer("Project", "Plugins", "ModdingEx");
+			OutError = FText::FromString(FString::Format(TEXT("Output dir for {0} could not be found"), {ModName}));
+			return false;
 		}
 
-		UE_LOG(LogModdingEx, Error, TEXT("Output dir could not be found"));
-		return false;
+		Target.bCheckUpToDate = Settings->bShouldCheckHash && HasPreviousBuild(Target);
 	}
 
-	UE_LOG(LogModdingEx, Log, TEXT("Output dir: %s"), *OutputDir);
-
-	const FString OutFileName = OutputDir / (ModName + ".pak");
+	if (Settings->bUsePersistentCookWorker)
+	{
+		// Usually already running, otherwise it starts up while the packages are being saved
+		FModCookWorker::Get().Prewarm();
+	}
 
 	if(Settings->bSaveAllBeforeBuilding)
 	{
@@ -231,112 +423,465 @@ bool UModBuilder::BuildMod(const FString& ModName, bool bIsSameContentError)
 		UE_LOG(LogModdingEx, Log, TEXT("Saved all packages"));
 	}
 
-	FMD5Hash InputHash = FMD5Hash();
-	if (Settings->bShouldCheckHash && FPaths::FileExists(OutFileName))
+	return true;
+}
+
+FModPakCompressionSettings UModBuilder::GetCompressionSettings(const FString& ModName, bool bForRelease)
+{
+	const auto Settings = GetDefault<UModdingExSettings>();
+
+	FName ProfileName = bForRelease ? Settings->ReleaseCompressionProfile : Settings->DefaultCompressionProfile;
+	if (const FName* ModProfileName = Settings->ModCompressionProfiles.Find(ModName))
+	{
+		ProfileName = *ModProfileName;
+	}
+
+	FModPakCompressionSettings Compression;
+
+	const FModPakCompressionProfile* Profile = Settings->CompressionProfiles.Find(ProfileName);
+	if (!Profile)
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Compression profile %s of %s doesn't exist, using the default compression"), *ProfileName.ToString(), *ModName);
+		return Compression;
+	}
+
+	switch (Profile->Format)
+	{
+	case EModPakCompressionFormat::None:
+		Compression.Format = NAME_None;
+		break;
+	case EModPakCompressionFormat::Zlib:
+		Compression.Format = NAME_Zlib;
+		break;
+	default:
+		Compression.Format = NAME_Oodle;
+		break;
+	}
+
+	switch (Profile->Compressor)
 	{
-		InputHash = FMD5Hash::HashFile(*OutFileName);
+	case EModOodleCompressor::Selkie:
+		Compression.Compressor = FOodleDataCompression::ECompressor::Selkie;
+		break;
+	case EModOodleCompressor::Mermaid:
+		Compression.Compressor = FOodleDataCompression::ECompressor::Mermaid;
+		break;
+	case EModOodleCompressor::Leviathan:
+		Compression.Compressor = FOodleDataCompression::ECompressor::Leviathan;
+		break;
+	default:
+		Compression.Compressor = FOodleDataCompression::ECompressor::Kraken;
+		break;
 	}
 
-	FScopedSlowTask SlowTask(4, FText::FromString(FString::Format(TEXT("Building {0} (this can take a while)"), {ModName})));
-	SlowTask.MakeDialog();
+	Compression.Level = static_cast<FOodleDataCompression::ECompressionLevel>(FMath::Clamp(Profile->Level, -4, 9));
+	Compression.BlockSize = FMath::Clamp(Profile->BlockSizeKB, 16, 4096) * 1024;
+
+	if (Profile->bSkipCompressedMedia)
+	{
+		Compression.UncompressedExtensions = Settings->CompressedMediaExtensions;
+	}
 
-	SlowTask.EnterProgressFrame(1, FText::FromString("Killing processes"));
+	return Compression;
+}
+
+TFuture<FModBuildResult> UModBuilder::BuildModAsync(const FString& ModName, bool bIsSameContentError, bool bForRelease)
+{
+	TArray<FModBuildTarget> Targets;
+	FText Error;
+	if (!PrepareBuild({ModName}, bForRelease, Targets, Error))
+	{
+		return MakeFulfilledPromise<FModBuildResult>(FModBuildResult::Failure(ModName, Error)).GetFuture();
+	}
+
+	ActiveBuildJob = MakeShared<FModBuildJob, ESPMode::ThreadSafe>(
+		FText::FromString(FString::Format(TEXT("Building {0}"), {ModName})),
+		[Targets, bIsSameContentError](FModBuildJob& Job)
+		{
+			return RunBuildMods(Job, Targets, bIsSameContentError)[0];
+		});
+
+	return ActiveBuildJob->Start().Next([](FModBuildResult Result)
+	{
+		ActiveBuildJob.Reset();
+		return Result;
+	});
+}
 
-	const TArray<FString>& ProcessesToKill = Settings->ProcessesToKill;
-	FPlatformProcess::FProcEnumerator ProcIter;
-	while (ProcIter.MoveNext())
+TFuture<TArray<FModBuildResult>> UModBuilder::BuildModsAsync(const TArray<FString>& ModNames, bool bIsSameContentError)
+{
+	TArray<FModBuildTarget> Targets;
+	FText Error;
+	if (ModNames.IsEmpty() || !PrepareBuild(ModNames, false, Targets, Error))
 	{
-		FPlatformProcess::FProcEnumInfo ProcInfo = ProcIter.GetCurrent();
-		const FString& Name = ProcInfo.GetName();
-		// UE_LOG(LogModdingEx, Log, TEXT("Found process: %s"), *Name);
-		if (ProcessesToKill.Contains(Name))
+		TArray<FModBuildResult> Results;
+		for (const FString& ModName : ModNames)
 		{
-			UE_LOG(LogModdingEx, Log, TEXT("Killing process: %s"), *Name);
-			FProcHandle ProcHandle = FPlatformProcess::OpenProcess(ProcInfo.GetPID());
-			FPlatformProcess::TerminateProc(ProcHandle);
-			FPlatformProcess::CloseProc(ProcHandle);
+			Results.Add(FModBuildResult::Failure(ModName, Error));
 		}
+		return MakeFulfilledPromise<TArray<FModBuildResult>>(MoveTemp(Results)).GetFuture();
 	}
 
-	UE_LOG(LogModdingEx, Log, TEXT("Building mod"));
+	const TSharedRef<TArray<FModBuildResult>, ESPMode::ThreadSafe> Results = MakeShared<TArray<FModBuildResult>, ESPMode::ThreadSafe>();
 
-	const FString ModPath = FString("/Game") / "Mods" / ModName;
-	EditDirectoriesToAlwaysCook(ModPath, false);	
+	ActiveBuildJob = MakeShared<FModBuildJob, ESPMode::ThreadSafe>(
+		FText::FromString(FString::Format(TEXT("Building {0} mods"), {Targets.Num()})),
+		[Targets, bIsSameContentError, Results](FModBuildJob& Job)
+		{
+			*Results = RunBuildMods(Job, Targets, bIsSameContentError);
 
-	SlowTask.EnterProgressFrame(1, FText::FromString("Cooking mod"));
-	const bool bCooked = Cook();
+			const int32 NumFailed = Algo::CountIf(*Results, [](const FModBuildResult& Result) { return !Result.bSuccess; });
 
-	// Remove the mod from the list of directories to always cook even if fail
-	EditDirectoriesToAlwaysCook(ModPath, true);
-	
-	if (!bCooked)
+			FModBuildResult Summary = NumFailed == 0
+				                          ? FModBuildResult::Success(FString(), FString())
+				                          : FModBuildResult::Failure(FString(), FText::FromString(
+					                          FString::Format(TEXT("{0} of {1} mods failed to build"), {NumFailed, Results->Num()})));
+			Summary.bCancelled = Job.IsCancelled();
+			return Summary;
+		});
+
+	return ActiveBuildJob->Start().Next([Results](const FModBuildResult&)
 	{
-		UE_LOG(LogModdingEx, Error, TEXT("Cooking failed"));
-		return false;
+		ActiveBuildJob.Reset();
+
+		FString SummaryText;
+		bool bAllSucceeded = true;
+		for (const FModBuildResult& Result : *Results)
+		{
+			const FString Status = Result.bSuccess ? (Result.bContentUnchanged ? FString("unchanged") : FString("built")) : Result.Error.ToString();
+			UE_LOG(LogModdingEx, Log, TEXT("%s: %s"), *Result.ModName, *Status);
+
+			SummaryText += FString::Printf(TEXT("%s%s: %s"), SummaryText.IsEmpty() ? TEXT("") : TEXT("\n"), *Result.ModName, *Status);
+			bAllSucceeded &= Result.bSuccess;
+		}
+
+		if (bAllSucceeded)
+		{
+			Notifications::ShowSuccessNotification(FText::FromString(SummaryText));
+		}
+		else
+		{
+			Notifications::ShowFailNotification(FText::FromString(SummaryText));
+		}
+
+		return *Results;
+	});
+}
+
+void UModBuilder::KillBlockingProcesses(const TArray<FModBuildTarget>& Targets)
+{
+	const auto Settings = GetDefault<UModdingExSettings>();
+	if (!Settings->bShouldKillProcesses)
+	{
+		return;
+	}
+
+	for (const FModBuildTarget& Target : Targets)
+	{
+		if (!FModFileLocks::IsFileLocked(Target.OutputPath))
+		{
+			continue;
+		}
+
+		for (const FModLockingProcess& Process : FModFileLocks::GetLockingProcesses(Target.OutputPath, Settings->ProcessesToKill))
+		{
+			if (!Settings->ProcessesToKill.Contains(Process.Name))
+			{
+				UE_LOG(LogModdingEx, Warning, TEXT("%s is opened by %s, add it to ProcessesToKill to close it before building"),
+				       *Target.OutputPath, *Process.Name);
+				continue;
+			}
+
+			if (!FModFileLocks::TerminateProcess(Process))
+			{
+				UE_LOG(LogModdingEx, Warning, TEXT("%s (%u) didn't exit in time"), *Process.Name, Process.ProcessId);
+			}
+		}
 	}
+}
+
+bool UModBuilder::HasPreviousBuild(const FModBuildTarget& Target)
+{
+	return FPaths::FileExists(Target.OutputPath) && FPaths::FileExists(FModPackManifest::GetManifestPath(Target.ModName)) &&
+		FPaths::FileExists(FModBuildManifest::GetManifestPath(Target.ModName));
+}
 
-	SlowTask.EnterProgressFrame(1, FText::FromString("Tracking files to pack"));
-	const FString& FilePath = CreateFilesTxt(
-		FPaths::ProjectDir() / "Saved" / "Cooked" / "Windows" / FApp::GetProjectName(), FString("Content") / "Mods" / ModName);
+bool UModBuilder::IsModUpToDate(const FModBuildTarget& Target, const FModBuildManifest& Manifest, const FModBuildManifest& PreviousManifest)
+{
+	const FString CookedDir = FPaths::ProjectDir() / "Saved" / "Cooked" / "Windows" / FApp::GetProjectName();
 
-	if (FilePath.IsEmpty())
+	FModPackManifest PackManifest;
+	if (!FModPackManifest::Load(Target.ModName, PackManifest) || !PackManifest.UsesCompression(Target.Compression) ||
+		!PackManifest.IsPakUpToDate(Target.OutputPath))
 	{
 		return false;
 	}
 
-	SlowTask.EnterProgressFrame(1, FText::FromString("Packing mod"));
-	if (!Pack(FilePath, OutFileName))
+	return FPaths::DirectoryExists(CookedDir / "Content" / "Mods" / Target.ModName) && Manifest.IsUnchanged(PreviousManifest);
+}
+
+bool UModBuilder::PrepareModCook(const FString& ModName, const FModBuildManifest& Manifest, const FModBuildManifest* PreviousManifest, FModCookRequest& Request)
+{
+	const FString ModPath = FString("/Game") / "Mods" / ModName;
+	const FString CookedDir = FPaths::ProjectDir() / "Saved" / "Cooked" / "Windows" / FApp::GetProjectName();
+
+	Request.ScanPaths.Add(ModPath);
+
+	if (PreviousManifest && FPaths::DirectoryExists(CookedDir / "Content" / "Mods" / ModName))
 	{
-		UE_LOG(LogModdingEx, Error, TEXT("Packing failed"));
-		return false;
+		DeleteCookedPackages(CookedDir, Manifest.GetRemovedModPackages(*PreviousManifest));
+
+		const TArray<FString> DirtyPackages = Manifest.GetDirtyModPackages(*PreviousManifest);
+		if (DirtyPackages.IsEmpty())
+		{
+			UE_LOG(LogModdingEx, Log, TEXT("%s: No packages changed since the last build, skipping cook"), *ModName);
+			return false;
+		}
+
+		if (FString::Join(Request.Packages, TEXT("+")).Len() + FString::Join(DirtyPackages, TEXT("+")).Len() <= MaxCookPackageListLength)
+		{
+			UE_LOG(LogModdingEx, Log, TEXT("%s: Recooking %d changed packages"), *ModName, DirtyPackages.Num());
+			Request.Packages.Append(DirtyPackages);
+			return true;
+		}
+
+		UE_LOG(LogModdingEx, Log, TEXT("%s: Too many changed packages for a scoped cook, cooking the whole mod"), *ModName);
 	}
 
-	if (!FPaths::FileExists(OutFileName))
+	Request.CookDirectories.Add(FPaths::ConvertRelativePathToFull(FPaths::ProjectContentDir() / "Mods" / ModName));
+	return true;
+}
+
+TArray<FModBuildResult> UModBuilder::RunBuildMods(FModBuildJob& Job, const TArray<FModBuildTarget>& Targets, bool bIsSameContentError)
+{
+	const auto Settings = GetDefault<UModdingExSettings>();
+
+	TArray<FModBuildResult> Results;
+	auto MakeResults = [&Targets, &Results](TFunctionRef<FModBuildResult(const FString&)> MakeResult)
 	{
-		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Packing failed. Output file not present. Check logs for more info."));
-		return false;
+		for (const FModBuildTarget& Target : Targets)
+		{
+			Results.Add(MakeResult(Target.ModName));
+		}
+		return Results;
+	};
+
+	for (const FModBuildTarget& Target : Targets)
+	{
+		UE_LOG(LogModdingEx, Log, TEXT("Output file: %s"), *Target.OutputPath);
 	}
 
-	const FMD5Hash OutputHash = FMD5Hash::HashFile(*OutFileName);
+	Job.SetStage(FText::FromString("Checking for locked files"), 0.0f);
+	KillBlockingProcesses(Targets);
 
-	if (Settings->bShouldCheckHash && bIsSameContentError && InputHash == OutputHash)
+	if (Job.IsCancelled())
 	{
-		UE_LOG(LogModdingEx, Error, TEXT("Output file is the same as the input file. Either packing failed or you didn't change the content."));
-		FMessageDialog::Open(EAppMsgType::Ok,
-		                     FText::FromString(
-			                     "Output file is the same as the input file. Either packing failed or you didn't change the content. Check logs for more info."));
-		return false;
+		return MakeResults(&FModBuildResult::Cancelled);
 	}
 
-	FNotificationInfo Info(FText::FromString("Mod built successfully!"));
-	Info.Image = FAppStyle::GetBrush(TEXT("LevelEditor.RecompileGameCode"));
-	Info.FadeInDuration = 0.1f;
-	Info.FadeOutDuration = 0.5f;
-	Info.ExpireDuration = 3.5f;
-	Info.bUseThrobber = false;
-	Info.bUseSuccessFailIcons = true;
-	Info.bUseLargeFont = true;
-	Info.bFireAndForget = false;
-	Info.bAllowThrottleWhenFrameRateIsLow = false;
-	const auto NotificationItem = FSlateNotificationManager::Get().AddNotification(Info);
-	NotificationItem->SetCompletionState(SNotificationItem::CS_Success);
-	NotificationItem->ExpireAndFadeout();
+	UE_LOG(LogModdingEx, Log, TEXT("Building mod"));
 
-	GEditor->PlayEditorSound(TEXT("/Engine/EditorSounds/Notifications/CompileSuccess_Cue.CompileSuccess_Cue"));
+	Job.SetStage(FText::FromString("Checking for changes"), 0.02f);
 
-	return true;
+	FModCookRequest Request;
+	Request.bScoped = Settings->bScopedCook;
+
+	// Mods that are skipped or only partially recooked are packed from what earlier builds cooked,
+	// a cook that isn't iterative would wipe all of that
+	Request.bIterate = true;
+
+	TArray<FModBuildManifest> Manifests;
+	TArray<FString> ModsToCook;
+	TArray<bool> UpToDate;
+	for (const FModBuildTarget& Target : Targets)
+	{
+		// Only files whose size or timestamp changed are hashed again
+		FModBuildManifest PreviousManifest;
+		const bool bLoadedManifest = FModBuildManifest::Load(Target.ModName, PreviousManifest);
+		FModBuildManifest& Manifest = Manifests.Add_GetRef(FModBuildManifest::Capture(Target.ModName, bLoadedManifest ? &PreviousManifest : nullptr));
+
+		// Nothing to cook or pack
+		const bool bUpToDate = Target.bCheckUpToDate && bLoadedManifest && IsModUpToDate(Target, Manifest, PreviousManifest);
+		UpToDate.Add(bUpToDate);
+		if (bUpToDate)
+		{
+			UE_LOG(LogModdingEx, Log, TEXT("%s didn't change since the last build"), *Target.ModName);
+			continue;
+		}
+
+		if (PrepareModCook(Target.ModName, Manifest, bLoadedManifest ? &PreviousManifest : nullptr, Request))
+		{
+			ModsToCook.Add(Target.ModName);
+		}
+	}
+
+	if (Job.IsCancelled())
+	{
+		return MakeResults(&FModBuildResult::Cancelled);
+	}
+
+	if (ModsToCook.Num() > 0)
+	{
+		Job.SetStage(FText::FromString(ModsToCook.Num() == 1 ? FString("Cooking mod") : FString::Printf(TEXT("Cooking %d mods"), ModsToCook.Num())), 0.05f, 0.8f);
+
+		// A failed or cancelled cook must never be mistaken for an up to date one
+		for (const FString& ModName : ModsToCook)
+		{
+			FModBuildManifest::Delete(ModName);
+		}
+
+		const bool bCooked = CookMods(Request, Job);
+
+		if (Job.IsCancelled())
+		{
+			return MakeResults(&FModBuildResult::Cancelled);
+		}
+
+		if (!bCooked)
+		{
+			UE_LOG(LogModdingEx, Error, TEXT("Cooking failed"));
+			return MakeResults([](const FString& ModName)
+			{
+				return FModBuildResult::Failure(ModName, FText::FromString("Cooking failed. Check logs for more info."));
+			});
+		}
+
+		for (int32 Index = 0; Index < Targets.Num(); ++Index)
+		{
+			if (ModsToCook.Contains(Targets[Index].ModName))
+			{
+				Manifests[Index].Save(Targets[Index].ModName);
+			}
+		}
+	}
+
+	Job.SetStage(FText::FromString(Targets.Num() == 1 ? FString("Packing mod") : FString::Printf(TEXT("Packing %d mods"), Targets.Num())), 0.8f);
+
+	// The packs are independent of each other, so they can run side by side
+	Results.SetNum(Targets.Num());
+	ParallelFor(Targets.Num(), [&](int32 Index)
+	{
+		Results[Index] = UpToDate[Index] ? MakeUnchangedResult(Targets[Index], bIsSameContentError) : PackMod(Job, Targets[Index], bIsSameContentError);
+	}, EParallelForFlags::Unbalanced);
+
+	if (!Settings->bUseUnrealPak && Settings->bUsePakCache)
+	{
+		FModPakBlockCache::Trim(static_cast<int64>(Settings->PakCacheSizeLimitMB) * 1024 * 1024);
+	}
+
+	return Results;
+}
+
+FModBuildResult UModBuilder::PackMod(FModBuildJob& Job, const FModBuildTarget& Target, bool bIsSameContentError)
+{
+	const auto Settings = GetDefault<UModdingExSettings>();
+	const FString& ModName = Target.ModName;
+	const FString& OutFileName = Target.OutputPath;
+
+	const FString CookedDir = FPaths::ProjectDir() / "Saved" / "Cooked" / "Windows" / FApp::GetProjectName();
+	const FString TrackingDir = FString("Content") / "Mods" / ModName;
+
+	const TArray<FModPakFileEntry> Files = GetCookedFiles(CookedDir, TrackingDir);
+	if (Files.IsEmpty())
+	{
+		return FModBuildResult::Failure(ModName, FText::FromString("No cooked files found. Check logs for more info."));
+	}
+
+	FModPackManifest PreviousManifest;
+	const bool bHasPreviousManifest = Settings->bShouldCheckHash && FModPackManifest::Load(ModName, PreviousManifest);
+
+	FModPackManifest Manifest = FModPackManifest::Capture(Files, Target.Compression, bHasPreviousManifest ? &PreviousManifest : nullptr);
+
+	// The pak only has to be written again if the cooked files changed or the pak was replaced since the last build
+	if (bHasPreviousManifest && Manifest.HasSameContent(PreviousManifest) && PreviousManifest.IsPakUpToDate(OutFileName))
+	{
+		UE_LOG(LogModdingEx, Log, TEXT("%s is up to date, skipping packing"), *OutFileName);
+		return MakeUnchangedResult(Target, bIsSameContentError);
+	}
+
+	bool bPacked = false;
+	if (Settings->bUseUnrealPak)
+	{
+		const FString& FilePath = WriteFilesTxt(Files, Target.Compression);
+
+		if (FilePath.IsEmpty())
+		{
+			return FModBuildResult::Failure(ModName, FText::FromString("Failed to track the cooked files"));
+		}
+
+		bPacked = PackInternal(FilePath, OutFileName, Target.Compression, &Job);
+	}
+	else
+	{
+		TOptional<FModPakBlockCache> Cache;
+		if (Settings->bUsePakCache)
+		{
+			Cache.Emplace(Target.Compression);
+		}
+
+		FString Error;
+		bPacked = FModPakWriter::WritePak(OutFileName, Files, Target.Compression, Cache.GetPtrOrNull(), [&Job] { return Job.IsCancelled(); }, Error);
+		if (!bPacked && !Job.IsCancelled())
+		{
+			UE_LOG(LogModdingEx, Error, TEXT("%s"), *Error);
+		}
+	}
+
+	if (!bPacked)
+	{
+		if (Job.IsCancelled())
+		{
+			return FModBuildResult::Cancelled(ModName);
+		}
+
+		UE_LOG(LogModdingEx, Error, TEXT("Packing %s failed"), *ModName);
+		return FModBuildResult::Failure(ModName, FText::FromString("Packing failed. Check logs for more info."));
+	}
+
+	if (!FPaths::FileExists(OutFileName))
+	{
+		return FModBuildResult::Failure(ModName, FText::FromString("Packing failed. Output file not present. Check logs for more info."));
+	}
+
+	Manifest.SetPak(OutFileName);
+	Manifest.Save(ModName);
+
+	return FModBuildResult::Success(ModName, OutFileName);
 }
 
 bool UModBuilder::PrepareModForRelease(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies)
+{
+	const TFuture<bool> Future = PrepareModForReleaseAsync(ModName, WebsiteUrl, Dependencies);
+
+	// A future that is ready right away means the mod was prepared without building or the build couldn't be started
+	return !Future.IsReady() || Future.Get();
+}
+
+TFuture<bool> UModBuilder::PrepareModForReleaseAsync(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies)
 {
 	const auto Settings = GetDefault<UModdingExSettings>();
-	
-	if (Settings->bAlwaysBuildBeforePrep && !BuildMod(ModName, !Settings->bPrepModWhenContentIsSame))
+
+	if (!Settings->bAlwaysBuildBeforePrep)
 	{
-		UE_LOG(LogModdingEx, Error, TEXT("Failed to prepare mod for release because building failed"));
-		return false;
+		return MakeFulfilledPromise<bool>(PrepareBuiltModForRelease(ModName, WebsiteUrl, Dependencies)).GetFuture();
 	}
-	
+
+	return BuildModAsync(ModName, !Settings->bPrepModWhenContentIsSame, true).Next([ModName, WebsiteUrl, Dependencies](const FModBuildResult& Result)
+	{
+		if (!Result.bSuccess)
+		{
+			UE_LOG(LogModdingEx, Error, TEXT("Failed to prepare mod for release because building failed"));
+			return false;
+		}
+
+		return PrepareBuiltModForRelease(ModName, WebsiteUrl, Dependencies);
+	});
+}
+
+bool UModBuilder::PrepareBuiltModForRelease(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies)
+{
+	const auto Settings = GetDefault<UModdingExSettings>();
+
 	// Fetch the mod author, description and version from the /Game/Mods/ModName/ModActor blueprint
 	FString ModAuthor = "Unknown";
 	FString ModDesc = "Unknown";
@@ -410,6 +955,8 @@ bool UModBuilder::PrepareModForRelease(const FString& ModName, const FString& We
 		return false;
 	}
 
+	WarnIfPakOutdated(ModName, OutFileName);
+
 	// Copy pak file from OutFileName to the staging dir/pak/
 	// There currently isn't any support for non-logic mods with Thunderstore, so this will have to be updated in the future when there is
 	const FString PakDir = StagingDir / "pak";
@@ -442,61 +989,6 @@ bool UModBuilder::PrepareModForRelease(const FString& ModName, const FString& We
 	return true;
 }
 
-void UModBuilder::EditDirectoriesToAlwaysCook(const FString& DirectoryToCook, const bool bShouldRemove)
-{
-	const FString IniFilePath = FPaths::ProjectConfigDir() / "DefaultGame.ini";
-	
-	FString FileContents;
-	FFileHelper::LoadFileToString(FileContents, *IniFilePath);
-	
-	TArray<FString> Lines;
-	FileContents.ParseIntoArrayLines(Lines);
-
-	const FString LineToModify = FString::Printf(TEXT("+DirectoriesToAlwaysCook=(Path=\"%s\")"), *DirectoryToCook);
-	
-	FString ModifiedContents;
-	bool bSectionFound = false;
-
-	for (FString& Line : Lines)
-	{
-		if (Line.Contains(TEXT("[/Script/UnrealEd.ProjectPackagingSettings]")))
-		{
-			bSectionFound = true;
-		}
-		else if (bSectionFound && Line.StartsWith(TEXT("[")))
-		{
-			if (!bShouldRemove)
-			{
-				ModifiedContents += LineToModify + TEXT("\n");
-			}
-			bSectionFound = false;
-		}
-		
-		if (bShouldRemove && bSectionFound && Line.TrimStart().Equals(LineToModify))
-		{
-			continue;
-		}
-		
-		ModifiedContents += Line + TEXT("\n");
-	}
-
-	if (bSectionFound && !bShouldRemove)
-	{
-		ModifiedContents += LineToModify + TEXT("\n");
-	}
-
-	const bool bSuccess = FFileHelper::SaveStringToFile(ModifiedContents, *IniFilePath);
-
-	if (!bSuccess)
-	{
-		UE_LOG(LogModdingEx, Error, TEXT("Failed to save file: %s"), *IniFilePath);
-	}
-	else
-	{
-		UE_LOG(LogModdingEx, Log, TEXT("File saved successfully: %s"), *IniFilePath);
-	}
-}
-
 bool UModBuilder::GetOutputPakDirectory(FString& OutDirectory, const FString& ModName)
 {
 	FString OutputDir;
@@ -534,6 +1026,8 @@ bool UModBuilder::ZipModBasic(const FString& ModName, const FString& ModManager)
 		return false;
 	}
 
+	WarnIfPakOutdated(ModName, OutFileName);
+
 	TArray<FString> FilesToZip;
 	FilesToZip.Add(OutFileName);
 
@@ -608,26 +1102,28 @@ bool UModBuilder::ZipModInternal(const FString& ModName, const TArray<FString>&
 
 	UE_LOG(LogModdingEx, Log, TEXT("Zipping mod to %s"), *ZipFilePath);
 
-	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	IFileHandle* ZipFile = PlatformFile.OpenWrite(*ZipFilePath);
+	FZipWriter ZipWriter{};
+	FZipError Error{};
 
-	if (!ZipFile)
+	bool bUpdating = Settings->bUpdateExistingZips && FPaths::FileExists(ZipFilePath);
+	if (bUpdating && !FZipWriter::TryUpdateZipWriter(ZipFilePath, ZipWriter, Error))
 	{
-		UE_LOG(LogModdingEx, Error, TEXT("Failed to open zip file for writing: %s"), *ZipFilePath);
+		UE_LOG(LogModdingEx, Warning, TEXT("Failed to open existing zip file: %s, error: %d, description: %s, writing it from scratch"),
+		       *ZipFilePath, Error.ErrorCode, Error.Description ? **Error.Description : TEXT(""));
+		bUpdating = false;
+	}
+
+	if (!bUpdating && !FZipWriter::TryCreateZipWriter(ZipFilePath, ZipWriter, Error))
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to open zip file for writing: %s, error: %d, description: %s"), *ZipFilePath,
+		       Error.ErrorCode, Error.Description ? **Error.Description : TEXT(""));
 		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Failed to open zip file for writing."));
 		return false;
 	}
 
-	FZipArchiveWriter ZipWriter(ZipFile);
+	TArray<TPair<FString, FString>> Entries;
 	for (const FString& FileName : FilesToZip)
 	{
-		IFileHandle* FileHandle = PlatformFile.OpenRead(*FileName);
-		if (!FileHandle)
-		{
-			UE_LOG(LogModdingEx, Error, TEXT("Failed to open file for reading: %s"), *FileName);
-			continue;
-		}
-		
 		FString ZipPath = FileName;
 		FPaths::MakePathRelativeTo(ZipPath, *CommonDirectory);
 		int32 Index;
@@ -635,15 +1131,46 @@ bool UModBuilder::ZipModInternal(const FString& ModName, const TArray<FString>&
 		{
 			ZipPath = ZipPath.Mid(Index + 1);
 		}
-		
-		const int64 FileSize = FileHandle->Size();
-		TArray<uint8> FileData;
-		FileData.SetNumUninitialized(FileSize);
-		FileHandle->Read(FileData.GetData(), FileSize);
-		
-		ZipWriter.AddFile(ZipPath, FileData, FDateTime::Now());
-		
-		delete FileHandle;
+
+		Entries.Emplace(MoveTemp(ZipPath), FileName);
+	}
+
+	if (Settings->bDeterministicZips)
+	{
+		// The order of found files depends on the file system
+		Entries.Sort([](const TPair<FString, FString>& A, const TPair<FString, FString>& B)
+		{
+			return A.Key.Compare(B.Key, ESearchCase::CaseSensitive) < 0;
+		});
+		ZipWriter.SetDeterministic(true);
+	}
+
+	for (const TPair<FString, FString>& Entry : Entries)
+	{
+		const FString& ZipPath = Entry.Key;
+		const FString& FileName = Entry.Value;
+
+		// Deflating a pak that is compressed already takes long and barely saves anything
+		const FString Extension = FPaths::GetExtension(FileName);
+		const bool bStore = Algo::Find(ZipStoredExtensions, Extension) || Settings->CompressedMediaExtensions.Contains(Extension) ||
+			!FZipWriter::IsWorthCompressing(FileName);
+		UE_LOG(LogModdingEx, Verbose, TEXT("Adding %s to zip (%s)"), *ZipPath, bStore ? TEXT("stored") : TEXT("deflated"));
+
+		// Only the path is recorded here, the file is streamed into the zip when it is closed
+		if (!ZipWriter.AddFile(ZipPath, FileName, bStore ? EZipCompression::Store : EZipCompression::Deflate, Error))
+		{
+			UE_LOG(LogModdingEx, Error, TEXT("Failed to open file for reading: %s, error: %d, description: %s"), *FileName,
+			       Error.ErrorCode, Error.Description ? **Error.Description : TEXT(""));
+			continue;
+		}
+	}
+
+	if (!ZipWriter.Close(Error))
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to write zip file: %s, error: %d, description: %s"), *ZipFilePath,
+		       Error.ErrorCode, Error.Description ? **Error.Description : TEXT(""));
+		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Failed to write zip file."));
+		return false;
 	}
 
 	FNotificationInfo Info(FText::FromString("Mod zipped successfully!"));
@@ -776,15 +1303,38 @@ FString* UModBuilder::FindFStringPropertyValue(UObject* Object, const FName& Pro
 }
 
 bool UModBuilder::ZipMod(const FString& ModName)
+{
+	const TFuture<bool> Future = ZipModAsync(ModName);
+
+	// A future that is ready right away means the mod was zipped without building or the build couldn't be started
+	return !Future.IsReady() || Future.Get();
+}
+
+TFuture<bool> UModBuilder::ZipModAsync(const FString& ModName)
 {
 	const auto Settings = GetDefault<UModdingExSettings>();
 
-	if (Settings->bAlwaysBuildBeforeZipping && !BuildMod(ModName, !Settings->bZipWhenContentIsSame))
+	if (!Settings->bAlwaysBuildBeforeZipping)
 	{
-		UE_LOG(LogModdingEx, Error, TEXT("Failed to zip mod because building failed"));
-		return false;
+		return MakeFulfilledPromise<bool>(ZipBuiltMod(ModName)).GetFuture();
 	}
 
+	return BuildModAsync(ModName, !Settings->bZipWhenContentIsSame, true).Next([ModName](const FModBuildResult& Result)
+	{
+		if (!Result.bSuccess)
+		{
+			UE_LOG(LogModdingEx, Error, TEXT("Failed to zip mod because building failed"));
+			return false;
+		}
+
+		return ZipBuiltMod(ModName);
+	});
+}
+
+bool UModBuilder::ZipBuiltMod(const FString& ModName)
+{
+	const auto Settings = GetDefault<UModdingExSettings>();
+
 	// Yes, this is nasty boolean logic, but only because more mod managers may be supported and we want an easy way to add them
 	bool bIsZipped = false;
 	if (Settings->bUsingThunderstore)
@@ -806,6 +1356,15 @@ bool UModBuilder::ZipMod(const FString& ModName)
 	return bIsZipped;
 }
 
+void UModBuilder::WarnIfPakOutdated(const FString& ModName, const FString& PakPath)
+{
+	FModPackManifest Manifest;
+	if (!FModPackManifest::Load(ModName, Manifest) || !Manifest.IsPakUpToDate(PakPath))
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("%s wasn't written by the last build of %s, it might be outdated"), *PakPath, *ModName);
+	}
+}
+
 bool UModBuilder::UninstallMod(const FString& ModName)
 {
 	FString OutFileName;
@@ -825,6 +1384,7 @@ bool UModBuilder::UninstallMod(const FString& ModName)
 		UE_LOG(LogModdingEx, Error, TEXT("Failed to delete file: %s"), *OutFileName);
 		return false;
 	}
-	
+
+	FModPackManifest::Delete(ModName);
 	return true;
 }
@@ -1,8 +1,11 @@
 #include "ModdingEx.h"
 
 #include "BlueprintCreator.h"
+#include "Build/ModBuildJob.h"
+#include "Build/ModCookWorker.h"
 #include "FModdingExSettingsCustomization.h"
 #include "ISettingsModule.h"
+#include "MessageLogModule.h"
 #include "ModdingExStyle.h"
 #include "ModdingExCommands.h"
 #include "ModBuilder.h"
@@ -13,6 +16,7 @@
 #include "StartupDialog.h"
 #include "Widgets/Docking/SDockTab.h"
 #include "Widgets/Layout/SBox.h"
+#include "Widgets/Layout/SScrollBox.h"
 #include "Widgets/Text/STextBlock.h"
 #include "ToolMenus.h"
 #include "UpdateDialog.h"
@@ -21,6 +25,7 @@
 #include "Misc/FileHelper.h"
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
+#include "Widgets/Input/SCheckBox.h"
 #include "Widgets/Input/SMultiLineEditableTextBox.h"
 #include "Widgets/Input/STextComboBox.h"
 
@@ -45,6 +50,12 @@ void FModdingExModule::StartupModule()
 		                                 GetMutableDefault<UModdingExSettings>());
 	}
 
+	FMessageLogInitializationOptions MessageLogOptions;
+	MessageLogOptions.bShowPages = true;
+	MessageLogOptions.bAllowClear = true;
+	FMessageLogModule& MessageLogModule = FModuleManager::LoadModuleChecked<FMessageLogModule>("MessageLog");
+	MessageLogModule.RegisterLogListing(FModBuildJob::MessageLogName, LOCTEXT("ModdingExMessageLog", "ModdingEx"), MessageLogOptions);
+
 	PluginCommands = MakeShareable(new FUICommandList);
 
 	PluginCommands->MapAction(
@@ -109,6 +120,13 @@ void FModdingExModule::ShutdownModule()
 	}
 	
 	FWorldDelegates::OnPostWorldInitialization.RemoveAll(this);
+
+	if (FMessageLogModule* MessageLogModule = FModuleManager::GetModulePtr<FMessageLogModule>("MessageLog"))
+	{
+		MessageLogModule->UnregisterLogListing(FModBuildJob::MessageLogName);
+	}
+
+	FModCookWorker::Get().Shutdown();
 }
 
 void FModdingExModule::RegisterMenus()
@@ -147,6 +165,33 @@ void FModdingExModule::RegisterMenus()
 
 						MenuBuilder.EndSection();
 
+						MenuBuilder.BeginSection("ModdingEx_BuildMultipleModsEntry", LOCTEXT("ModdingEx_BuildMultipleMods", "Build Multiple Mods"));
+
+						MenuBuilder.AddMenuEntry(
+							LOCTEXT("ModdingEx_BuildAllMods", "Build All"),
+							LOCTEXT("ModdingEx_BuildAllMods_Tooltip", "Build every mod in a single cook"),
+							FSlateIcon(),
+							FUIAction(FExecuteAction::CreateLambda([Mods]
+							{
+								UModBuilder::BuildModsAsync(Mods);
+							}), FCanExecuteAction::CreateLambda([Mods]
+							{
+								return Mods.Num() > 0;
+							}))
+						);
+
+						MenuBuilder.AddMenuEntry(
+							LOCTEXT("ModdingEx_BuildSelectedMods", "Build Selected..."),
+							LOCTEXT("ModdingEx_BuildSelectedMods_Tooltip", "Choose the mods to build in a single cook"),
+							FSlateIcon(),
+							FUIAction(FExecuteAction::CreateLambda([this]
+							{
+								OnOpenBuildSelectedMods();
+							}))
+						);
+
+						MenuBuilder.EndSection();
+
 						const auto Settings = GetDefault<UModdingExSettings>();
 						if (Settings->bUsingThunderstore)
 						{
@@ -315,9 +360,20 @@ void FModdingExModule::RegisterMenus()
 void FModdingExModule::OnPostWorldInit(UWorld* World, const UWorld::InitializationValues IVS)
 {
 	FWorldDelegates::OnPostWorldInitialization.RemoveAll(this);
+
+	// The cook worker runs this module as well
+	if (IsRunningCommandlet())
+	{
+		return;
+	}
 	
 	UModdingExSettings* Settings = GetMutableDefault<UModdingExSettings>();
 
+	if (Settings->bUsePersistentCookWorker && Settings->bPrewarmCookWorkerOnStartup)
+	{
+		FModCookWorker::Get().Prewarm();
+	}
+
 	if(Settings->bIsFirstStart)
 	{
 		StartupDialog::ShowDialog(LOCTEXT("ModdingEx", "ModdingEx"), LOCTEXT("ModdingEx_FirstStartHeader", "Welcome to ModdingEx!"), LOCTEXT("ModdingEx_FirstStart", "This Plugin makes heavy use of tooltips. If you are not sure what an option does, hover over it to get a description."));
@@ -774,6 +830,94 @@ void FModdingExModule::OnOpenPrepareModForRelease(const FString& Mod) const
     FSlateApplication::Get().AddWindow(Window);
 }
 
+void FModdingExModule::OnOpenBuildSelectedMods() const
+{
+	TArray<FString> Mods;
+	ModdingAssets::GetMods(Mods);
+
+	const TSharedRef<TSet<FString>> SelectedMods = MakeShared<TSet<FString>>();
+
+	const TSharedRef<SWindow> Window = SNew(SWindow)
+		.Title(LOCTEXT("ModdingEx_BuildSelectedModsTitle", "Build Selected Mods"))
+		.ClientSize(FVector2D(350, 400))
+		.SupportsMaximize(false)
+		.SupportsMinimize(false);
+
+	const TSharedRef<SVerticalBox> ModList = SNew(SVerticalBox);
+	for (const FString& Mod : Mods)
+	{
+		ModList->AddSlot()
+		.AutoHeight()
+		.Padding(2)
+		[
+			SNew(SCheckBox)
+			.OnCheckStateChanged_Lambda([SelectedMods, Mod](ECheckBoxState State)
+			{
+				if (State == ECheckBoxState::Checked)
+				{
+					SelectedMods->Add(Mod);
+				}
+				else
+				{
+					SelectedMods->Remove(Mod);
+				}
+			})
+			[
+				SNew(STextBlock)
+				.Text(FText::FromString(Mod))
+			]
+		];
+	}
+
+	Window->SetContent(
+		SNew(SVerticalBox)
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.Padding(7)
+		[
+			SNew(STextBlock)
+			.Text(FText::FromString("The selected mods are cooked together and packed in parallel"))
+			.AutoWrapText(true)
+		]
+		+ SVerticalBox::Slot()
+		.FillHeight(1)
+		.Padding(7)
+		[
+			SNew(SScrollBox)
+			+ SScrollBox::Slot()
+			[
+				ModList
+			]
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.Padding(7)
+		[
+			SNew(SPositiveActionButton)
+			.ToolTipText(FText::FromString("Build the selected mods"))
+			.Text(FText::FromString("Build"))
+			.IsEnabled_Lambda([SelectedMods]
+			{
+				return SelectedMods->Num() > 0;
+			})
+			.OnClicked_Lambda([Window, Mods, SelectedMods]()
+			{
+				// Keep the order of the mod list
+				TArray<FString> ModsToBuild = Mods.FilterByPredicate([SelectedMods](const FString& Mod)
+				{
+					return SelectedMods->Contains(Mod);
+				});
+				UModBuilder::BuildModsAsync(ModsToBuild);
+
+				Window->RequestDestroyWindow();
+				return FReply::Handled();
+			})
+		]
+	);
+
+	FSlateApplication::Get().AddWindow(Window);
+}
+
 FReply FModdingExModule::TryStartGame() const
 {
 	const auto Settings = GetDefault<UModdingExSettings>();
@@ -802,11 +946,19 @@ FReply FModdingExModule::TryStartGame() const
 		if(!Mod.IsEmpty() && Mod != "None")
 		{
 			UE_LOG(LogModdingEx, Log, TEXT("Starting game after building %s"), *Mod);
-			if(!UModBuilder::BuildMod(Mod, !Settings->bDontCheckHashOnGameStart) && !Settings->bShouldStartGameAfterFailedBuild)
+			UModBuilder::BuildModAsync(Mod, !Settings->bDontCheckHashOnGameStart).Next([GamePath, Mod](const FModBuildResult& Result)
 			{
-				UE_LOG(LogModdingEx, Error, TEXT("Failed to build mod %s"), *Mod);
-				return FReply::Handled();
-			}
+				// Never start the game when the user cancelled the build, an unchanged mod is still installed from the last build
+				if(!Result.bSuccess && !Result.bContentUnchanged && (Result.bCancelled || !GetDefault<UModdingExSettings>()->bShouldStartGameAfterFailedBuild))
+				{
+					UE_LOG(LogModdingEx, Error, TEXT("Failed to build mod %s"), *Mod);
+					return;
+				}
+
+				FPlatformProcess::CreateProc(*GamePath, nullptr, true, false, false, nullptr, 0, nullptr, nullptr);
+			});
+
+			return FReply::Handled();
 		}
 	}
 
@@ -0,0 +1,142 @@
+﻿#include "Pak/ModPakBlockCache.h"
+
+#include "ModdingEx.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Pak/ModPakWriter.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	/** Bump when the layout of the entries changes */
+	constexpr uint32 CacheVersion = 1;
+
+	constexpr uint32 CacheMagic = 0x4d504243;
+}
+
+FModPakBlockCache::FModPakBlockCache(const FModPakCompressionSettings& Compression)
+{
+	const FString Settings = FString::Printf(TEXT("%u|%s"), CacheVersion, *Compression.GetKey());
+
+	const FTCHARToUTF8 SettingsUtf8(*Settings);
+	SettingsHash = FBlake3::HashBuffer(SettingsUtf8.Get(), SettingsUtf8.Length());
+}
+
+FString FModPakBlockCache::GetCacheDir()
+{
+	return FPaths::ProjectIntermediateDir() / "ModdingEx" / "PakCache";
+}
+
+FBlake3Hash FModPakBlockCache::MakeKey(const TArray<uint8>& Uncompressed) const
+{
+	FBlake3 Hasher;
+	Hasher.Update(SettingsHash.GetBytes(), sizeof(FBlake3Hash::ByteArray));
+	Hasher.Update(Uncompressed.GetData(), Uncompressed.Num());
+	return Hasher.Finalize();
+}
+
+FString FModPakBlockCache::GetEntryPath(const FBlake3Hash& Key) const
+{
+	const FString Hex = BytesToHex(Key.GetBytes(), sizeof(FBlake3Hash::ByteArray));
+	return GetCacheDir() / Hex.Left(2) / Hex + TEXT(".bin");
+}
+
+bool FModPakBlockCache::Load(const FBlake3Hash& Key, int64 UncompressedSize, TArray<TArray<uint8>>& OutBlocks) const
+{
+	const FString Path = GetEntryPath(Key);
+
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Path, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Data);
+
+	uint32 Magic = 0;
+	int64 StoredSize = 0;
+	Reader << Magic;
+	Reader << StoredSize;
+	Reader << OutBlocks;
+
+	if (Reader.IsError() || Magic != CacheMagic || StoredSize != UncompressedSize)
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Ignoring invalid pak cache entry %s"), *Path);
+		OutBlocks.Empty();
+		return false;
+	}
+
+	// Keeps recently used entries from being trimmed
+	IFileManager::Get().SetTimeStamp(*Path, FDateTime::UtcNow());
+	return true;
+}
+
+void FModPakBlockCache::Store(const FBlake3Hash& Key, int64 UncompressedSize, const TArray<TArray<uint8>>& Blocks) const
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+
+	uint32 Magic = CacheMagic;
+	Writer << Magic;
+	Writer << UncompressedSize;
+	Writer << const_cast<TArray<TArray<uint8>>&>(Blocks);
+
+	// Parallel packs can store the same entry, write to a unique file first so readers never see a partial entry
+	const FString Path = GetEntryPath(Key);
+	const FString TempPath = FPaths::CreateTempFilename(*FPaths::GetPath(Path), TEXT("entry"), TEXT(".tmp"));
+
+	if (!FFileHelper::SaveArrayToFile(Data, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true, true, false, true))
+	{
+		UE_LOG(LogModdingEx, Warning, TEXT("Failed to store pak cache entry %s"), *Path);
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+	}
+}
+
+void FModPakBlockCache::Trim(int64 MaxSize)
+{
+	struct FCacheFile
+	{
+		FString Path;
+		int64 Size;
+		FDateTime LastUsed;
+	};
+
+	TArray<FCacheFile> Files;
+	int64 TotalSize = 0;
+
+	IFileManager::Get().IterateDirectoryStatRecursively(*GetCacheDir(), [&Files, &TotalSize](const TCHAR* Path, const FFileStatData& Stat)
+	{
+		if (!Stat.bIsDirectory)
+		{
+			Files.Add({Path, Stat.FileSize, Stat.ModificationTime});
+			TotalSize += Stat.FileSize;
+		}
+		return true;
+	});
+
+	if (TotalSize <= MaxSize)
+	{
+		return;
+	}
+
+	Files.Sort([](const FCacheFile& A, const FCacheFile& B) { return A.LastUsed < B.LastUsed; });
+
+	int32 NumDeleted = 0;
+	for (const FCacheFile& File : Files)
+	{
+		if (TotalSize <= MaxSize)
+		{
+			break;
+		}
+
+		if (IFileManager::Get().Delete(*File.Path, false, false, true))
+		{
+			TotalSize -= File.Size;
+			++NumDeleted;
+		}
+	}
+
+	UE_LOG(LogModdingEx, Log, TEXT("Trimmed %d entries from the pak cache"), NumDeleted);
+}
@@ -0,0 +1,635 @@
+﻿#include "Pak/ModPakWriter.h"
+
+#include "IPlatformFilePak.h"
+#include "ModdingEx.h"
+#include "Async/ParallelFor.h"
+#include "HAL/Event.h"
+#include "HAL/FileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/SecureHash.h"
+#include "Pak/ModPakBlockCache.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	/**
+	 * Version 8 is the newest version with the plain filename -> entry index.
+	 * Every 5.x runtime still mounts it and it doesn't depend on the engine's private index encoding.
+	 */
+	constexpr int32 PakVersion = FPakInfo::PakFile_Version_FNameBasedCompressionMethod;
+
+	/** Amount of uncompressed data one writer reads and compresses at once */
+	constexpr int64 BatchSize = 64 * 1024 * 1024;
+
+	/** Larger files aren't loaded as a whole but streamed a chunk at a time */
+	constexpr int64 MaxBatchedFileSize = 32 * 1024 * 1024;
+
+	/** Amount of a streamed file that is compressed at once */
+	constexpr int64 StreamChunkSize = 16 * 1024 * 1024;
+
+	/** File data that all writers together hold in memory, several mods are packed side by side */
+	constexpr int64 MemoryBudget = 256 * 1024 * 1024;
+
+	/** Limits the file data held by all writers together, a writer waits until its batch fits */
+	class FPakMemoryBudget
+	{
+	public:
+		static FPakMemoryBudget& Get()
+		{
+			static FPakMemoryBudget Budget;
+			return Budget;
+		}
+
+		/** A request larger than the budget is let through once nothing else is held */
+		void Acquire(int64 Bytes)
+		{
+			while (true)
+			{
+				{
+					FScopeLock ScopeLock(&Lock);
+					if (Used == 0 || Used + Bytes <= MemoryBudget)
+					{
+						Used += Bytes;
+						return;
+					}
+					Released->Reset();
+				}
+				Released->Wait();
+			}
+		}
+
+		void Release(int64 Bytes)
+		{
+			FScopeLock ScopeLock(&Lock);
+			Used -= Bytes;
+			Released->Trigger();
+		}
+
+	private:
+		FCriticalSection Lock;
+		FEventRef Released{EEventMode::ManualReset};
+		int64 Used = 0;
+	};
+
+	/** Holds the bytes of the budget for its lifetime, twice the input size to leave room for the compressed copies */
+	struct FScopedPakMemory
+	{
+		explicit FScopedPakMemory(int64 InputBytes) : Bytes(InputBytes * 2)
+		{
+			FPakMemoryBudget::Get().Acquire(Bytes);
+		}
+
+		~FScopedPakMemory()
+		{
+			FPakMemoryBudget::Get().Release(Bytes);
+		}
+
+		const int64 Bytes;
+	};
+
+	struct FPakFileData
+	{
+		TArray<uint8> Uncompressed;
+
+		/** Empty if the file is stored uncompressed */
+		TArray<TArray<uint8>> CompressedBlocks;
+
+		bool bReadFailed = false;
+
+		/** Set if the compressed blocks were loaded from the cache */
+		bool bCached = false;
+
+		bool bSkipCompression = false;
+	};
+
+	bool CompressBlock(const FModPakCompressionSettings& Compression, const uint8* Data, int32 Size, TArray<uint8>& OutCompressed)
+	{
+		if (Compression.Format == NAME_Oodle)
+		{
+			OutCompressed.SetNumUninitialized(FOodleDataCompression::CompressedBufferSizeNeeded(Size));
+			const int64 CompressedSize = FOodleDataCompression::Compress(OutCompressed.GetData(), OutCompressed.Num(), Data, Size,
+			                                                             Compression.Compressor, Compression.Level);
+			OutCompressed.SetNum(CompressedSize, false);
+			return CompressedSize > 0;
+		}
+
+		int32 CompressedSize = FCompression::CompressMemoryBound(Compression.Format, Size);
+		OutCompressed.SetNumUninitialized(CompressedSize);
+		if (!FCompression::CompressMemory(Compression.Format, OutCompressed.GetData(), CompressedSize, Data, Size))
+		{
+			return false;
+		}
+		OutCompressed.SetNum(CompressedSize, false);
+		return true;
+	}
+
+	/** Compresses the blocks of all files in the batch in parallel, files that don't get smaller are stored */
+	void CompressBatch(TArray<FPakFileData>& Batch, const FModPakCompressionSettings& Compression, const FModPakBlockCache* Cache)
+	{
+		struct FBlockRef
+		{
+			int32 FileIndex;
+			int32 BlockIndex;
+		};
+
+		TArray<FBlake3Hash> CacheKeys;
+		if (Cache)
+		{
+			CacheKeys.SetNum(Batch.Num());
+			ParallelFor(Batch.Num(), [&](int32 Index)
+			{
+				FPakFileData& File = Batch[Index];
+				if (File.bSkipCompression)
+				{
+					return;
+				}
+
+				CacheKeys[Index] = Cache->MakeKey(File.Uncompressed);
+				File.bCached = Cache->Load(CacheKeys[Index], File.Uncompressed.Num(), File.CompressedBlocks);
+			});
+		}
+
+		TArray<FBlockRef> Blocks;
+		for (int32 FileIndex = 0; FileIndex < Batch.Num(); ++FileIndex)
+		{
+			FPakFileData& File = Batch[FileIndex];
+			if (File.bCached || File.bSkipCompression)
+			{
+				continue;
+			}
+
+			const int32 NumBlocks = FMath::DivideAndRoundUp(File.Uncompressed.Num(), Compression.BlockSize);
+			File.CompressedBlocks.SetNum(NumBlocks);
+
+			for (int32 BlockIndex = 0; BlockIndex < NumBlocks; ++BlockIndex)
+			{
+				Blocks.Add({FileIndex, BlockIndex});
+			}
+		}
+
+		TArray<bool> FailedFiles;
+		FailedFiles.SetNumZeroed(Batch.Num());
+
+		ParallelFor(Blocks.Num(), [&](int32 Index)
+		{
+			const FBlockRef& Block = Blocks[Index];
+			FPakFileData& File = Batch[Block.FileIndex];
+
+			const int64 Start = static_cast<int64>(Block.BlockIndex) * Compression.BlockSize;
+			const int64 Size = FMath::Min<int64>(Compression.BlockSize, File.Uncompressed.Num() - Start);
+
+			if (!CompressBlock(Compression, File.Uncompressed.GetData() + Start, static_cast<int32>(Size), File.CompressedBlocks[Block.BlockIndex]))
+			{
+				FailedFiles[Block.FileIndex] = true;
+			}
+		});
+
+		for (int32 FileIndex = 0; FileIndex < Batch.Num(); ++FileIndex)
+		{
+			FPakFileData& File = Batch[FileIndex];
+			if (File.bCached || File.bSkipCompression)
+			{
+				continue;
+			}
+
+			int64 CompressedSize = 0;
+			for (const TArray<uint8>& Block : File.CompressedBlocks)
+			{
+				CompressedSize += Block.Num();
+			}
+
+			if (FailedFiles[FileIndex] || CompressedSize >= File.Uncompressed.Num())
+			{
+				File.CompressedBlocks.Empty();
+			}
+		}
+
+		if (Cache)
+		{
+			ParallelFor(Batch.Num(), [&](int32 Index)
+			{
+				if (!Batch[Index].bCached && !Batch[Index].bSkipCompression && !FailedFiles[Index])
+				{
+					Cache->Store(CacheKeys[Index], Batch[Index].Uncompressed.Num(), Batch[Index].CompressedBlocks);
+				}
+			});
+		}
+	}
+
+	/**
+	 * Same as UnrealPak with -patchpaddingalign, an entry smaller than the alignment that would cross a multiple of it
+	 * starts at the next multiple instead, the gap is filled with zeros
+	 */
+	void PadEntry(FArchive& Writer, const FPakEntry& Entry)
+	{
+		const int64 EntrySize = Entry.GetSerializedSize(PakVersion) + Entry.Size;
+		const int64 Offset = Writer.Tell();
+		if (EntrySize >= FModPakWriter::PatchPaddingAlign ||
+			Offset / FModPakWriter::PatchPaddingAlign == (Offset + EntrySize - 1) / FModPakWriter::PatchPaddingAlign)
+		{
+			return;
+		}
+
+		TArray<uint8> Padding;
+		Padding.SetNumZeroed(Align(Offset, FModPakWriter::PatchPaddingAlign) - Offset);
+		Writer.Serialize(Padding.GetData(), Padding.Num());
+	}
+
+	FPakEntry WriteEntry(FArchive& Writer, const FPakFileData& File, uint32 CompressionMethodIndex, int32 BlockSize)
+	{
+		FPakEntry Entry;
+		Entry.UncompressedSize = File.Uncompressed.Num();
+
+		FSHA1 Hasher;
+
+		if (File.CompressedBlocks.Num() > 0)
+		{
+			Entry.CompressionMethodIndex = CompressionMethodIndex;
+			Entry.CompressionBlockSize = BlockSize;
+			Entry.CompressionBlocks.SetNum(File.CompressedBlocks.Num());
+
+			// Block offsets are relative to the start of the entry, which begins with the serialized entry itself
+			int64 BlockStart = Entry.GetSerializedSize(PakVersion);
+			for (int32 BlockIndex = 0; BlockIndex < File.CompressedBlocks.Num(); ++BlockIndex)
+			{
+				const TArray<uint8>& Block = File.CompressedBlocks[BlockIndex];
+				Entry.CompressionBlocks[BlockIndex].CompressedStart = BlockStart;
+				Entry.CompressionBlocks[BlockIndex].CompressedEnd = BlockStart + Block.Num();
+				BlockStart += Block.Num();
+
+				Hasher.Update(Block.GetData(), Block.Num());
+				Entry.Size += Block.Num();
+			}
+		}
+		else
+		{
+			Entry.Size = File.Uncompressed.Num();
+			Hasher.Update(File.Uncompressed.GetData(), File.Uncompressed.Num());
+		}
+
+		Hasher.Final();
+		Hasher.GetHash(Entry.Hash);
+
+		PadEntry(Writer, Entry);
+		Entry.Offset = Writer.Tell();
+
+		// The header in front of the data doesn't store its own offset, only the index does
+		FPakEntry Header = Entry;
+		Header.Offset = 0;
+		Header.Serialize(Writer, PakVersion);
+
+		if (File.CompressedBlocks.Num() > 0)
+		{
+			for (const TArray<uint8>& Block : File.CompressedBlocks)
+			{
+				Writer.Serialize(const_cast<uint8*>(Block.GetData()), Block.Num());
+			}
+		}
+		else
+		{
+			Writer.Serialize(const_cast<uint8*>(File.Uncompressed.GetData()), File.Uncompressed.Num());
+		}
+
+		return Entry;
+	}
+
+	/** Copies the file into the pak a chunk at a time */
+	bool CopyFile(FArchive& Writer, const FString& SourcePath, int64 Size)
+	{
+		const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*SourcePath));
+		if (!Reader)
+		{
+			return false;
+		}
+
+		TArray<uint8> Chunk;
+		for (int64 Offset = 0; Offset < Size && !Reader->IsError(); Offset += StreamChunkSize)
+		{
+			const FScopedPakMemory Memory(StreamChunkSize);
+			Chunk.SetNumUninitialized(FMath::Min(StreamChunkSize, Size - Offset));
+			Reader->Serialize(Chunk.GetData(), Chunk.Num());
+			Writer.Serialize(Chunk.GetData(), Chunk.Num());
+		}
+
+		return !Reader->IsError();
+	}
+
+	/**
+	 * Writes a file that is too large for a batch, a chunk at a time.
+	 * The header in front of the data needs the sizes and hash of the compressed blocks,
+	 * so they go through a temporary file first. Streamed files aren't cached since the cache key hashes the whole file.
+	 */
+	bool WriteStreamedEntry(FArchive& Writer, const FString& SourcePath, int64 FileSize, bool bCompress, const FModPakCompressionSettings& Compression,
+	                        uint32 CompressionMethodIndex, const FString& SpillPath, FPakEntry& OutEntry, FString& OutError)
+	{
+		ON_SCOPE_EXIT
+		{
+			IFileManager::Get().Delete(*SpillPath, false, false, true);
+		};
+
+		// Whole blocks per chunk so the blocks are the same as if the file was compressed at once
+		const int64 ChunkSize = FMath::Max<int64>(1, StreamChunkSize / Compression.BlockSize) * Compression.BlockSize;
+
+		FSHA1 RawHasher;
+		FSHA1 CompressedHasher;
+		TArray<int64> BlockSizes;
+		int64 CompressedSize = 0;
+		bool bCompressed = bCompress;
+		{
+			const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*SourcePath));
+			const TUniquePtr<FArchive> Spill(bCompress ? IFileManager::Get().CreateFileWriter(*SpillPath) : nullptr);
+			if (!Reader || (bCompress && !Spill))
+			{
+				OutError = FString::Printf(TEXT("Failed to read %s"), *SourcePath);
+				return false;
+			}
+
+			TArray<uint8> Chunk;
+			TArray<TArray<uint8>> Blocks;
+			for (int64 Offset = 0; Offset < FileSize; Offset += ChunkSize)
+			{
+				const FScopedPakMemory Memory(ChunkSize);
+				Chunk.SetNumUninitialized(FMath::Min(ChunkSize, FileSize - Offset));
+				Reader->Serialize(Chunk.GetData(), Chunk.Num());
+				if (Reader->IsError())
+				{
+					OutError = FString::Printf(TEXT("Failed to read %s"), *SourcePath);
+					return false;
+				}
+
+				RawHasher.Update(Chunk.GetData(), Chunk.Num());
+				if (!bCompressed)
+				{
+					continue;
+				}
+
+				Blocks.Reset();
+				Blocks.SetNum(FMath::DivideAndRoundUp<int64>(Chunk.Num(), Compression.BlockSize));
+
+				std::atomic<bool> bFailed = false;
+				ParallelFor(Blocks.Num(), [&](int32 Index)
+				{
+					const int64 Start = static_cast<int64>(Index) * Compression.BlockSize;
+					const int64 Size = FMath::Min<int64>(Compression.BlockSize, Chunk.Num() - Start);
+					if (!CompressBlock(Compression, Chunk.GetData() + Start, static_cast<int32>(Size), Blocks[Index]))
+					{
+						bFailed = true;
+					}
+				});
+
+				if (bFailed)
+				{
+					bCompressed = false;
+					continue;
+				}
+
+				for (TArray<uint8>& Block : Blocks)
+				{
+					CompressedHasher.Update(Block.GetData(), Block.Num());
+					Spill->Serialize(Block.GetData(), Block.Num());
+					BlockSizes.Add(Block.Num());
+					CompressedSize += Block.Num();
+				}
+			}
+
+			// Like batched files, files that don't get smaller are stored
+			bCompressed &= CompressedSize < FileSize;
+			if (Spill && !Spill->Close())
+			{
+				bCompressed = false;
+			}
+		}
+
+		FPakEntry Entry;
+		Entry.UncompressedSize = FileSize;
+		if (bCompressed)
+		{
+			Entry.CompressionMethodIndex = CompressionMethodIndex;
+			Entry.CompressionBlockSize = Compression.BlockSize;
+			Entry.CompressionBlocks.SetNum(BlockSizes.Num());
+
+			int64 BlockStart = Entry.GetSerializedSize(PakVersion);
+			for (int32 BlockIndex = 0; BlockIndex < BlockSizes.Num(); ++BlockIndex)
+			{
+				Entry.CompressionBlocks[BlockIndex].CompressedStart = BlockStart;
+				Entry.CompressionBlocks[BlockIndex].CompressedEnd = BlockStart + BlockSizes[BlockIndex];
+				BlockStart += BlockSizes[BlockIndex];
+			}
+
+			Entry.Size = CompressedSize;
+			CompressedHasher.Final();
+			CompressedHasher.GetHash(Entry.Hash);
+		}
+		else
+		{
+			Entry.Size = FileSize;
+			RawHasher.Final();
+			RawHasher.GetHash(Entry.Hash);
+		}
+
+		PadEntry(Writer, Entry);
+		Entry.Offset = Writer.Tell();
+
+		FPakEntry Header = Entry;
+		Header.Offset = 0;
+		Header.Serialize(Writer, PakVersion);
+
+		if (!CopyFile(Writer, bCompressed ? SpillPath : SourcePath, Entry.Size))
+		{
+			OutError = FString::Printf(TEXT("Failed to read %s"), bCompressed ? *SpillPath : *SourcePath);
+			return false;
+		}
+
+		OutEntry = Entry;
+		return true;
+	}
+
+	/** Same mount point UnrealPak would pick, the common directory of all files */
+	FString GetMountPoint(const TArray<FModPakFileEntry>& Files)
+	{
+		FString CommonPath = FPaths::GetPath(Files[0].DestPath);
+		for (const FModPakFileEntry& File : Files)
+		{
+			while (!CommonPath.IsEmpty() && !File.DestPath.StartsWith(CommonPath + TEXT("/")))
+			{
+				CommonPath = FPaths::GetPath(CommonPath);
+			}
+		}
+
+		return CommonPath.IsEmpty() ? FString("../../../") : FString("../../../") / CommonPath + TEXT("/");
+	}
+}
+
+FString FModPakCompressionSettings::GetKey() const
+{
+	TArray<FString> SortedExtensions = UncompressedExtensions;
+	SortedExtensions.Sort();
+
+	return FString::Printf(TEXT("%d|%s|%d|%d|%d|%s"),
+	                       PakVersion,
+	                       *Format.ToString(),
+	                       static_cast<int32>(Compressor),
+	                       static_cast<int32>(Level),
+	                       BlockSize,
+	                       *FString::Join(SortedExtensions, TEXT(",")).ToLower());
+}
+
+bool FModPakWriter::WritePak(const FString& OutputPath, const TArray<FModPakFileEntry>& Files, const FModPakCompressionSettings& Compression,
+                             const FModPakBlockCache* Cache, TFunctionRef<bool()> ShouldCancel, FString& OutError)
+{
+	if (Files.IsEmpty())
+	{
+		OutError = TEXT("No files to pack");
+		return false;
+	}
+
+	const FString TempPath = OutputPath + TEXT(".tmp");
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempPath));
+	if (!Writer)
+	{
+		OutError = FString::Printf(TEXT("Failed to open %s for writing"), *TempPath);
+		return false;
+	}
+
+	auto Abort = [&Writer, &TempPath]
+	{
+		Writer.Reset();
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+		return false;
+	};
+
+	FPakInfo Info;
+	uint32 CompressionMethodIndex = 0;
+	if (Compression.Format != NAME_None)
+	{
+		CompressionMethodIndex = Info.CompressionMethods.AddUnique(Compression.Format);
+	}
+
+	TArray<FPakEntry> Entries;
+	Entries.Reserve(Files.Num());
+
+	TArray<int64> FileSizes;
+	FileSizes.SetNum(Files.Num());
+	ParallelFor(Files.Num(), [&Files, &FileSizes](int32 Index)
+	{
+		FileSizes[Index] = FMath::Max<int64>(IFileManager::Get().FileSize(*Files[Index].SourcePath), 0);
+	});
+
+	auto ShouldCompress = [&Compression, CompressionMethodIndex](const FString& SourcePath)
+	{
+		return CompressionMethodIndex != 0 && !Compression.UncompressedExtensions.Contains(FPaths::GetExtension(SourcePath));
+	};
+
+	int32 BatchStart = 0;
+	while (BatchStart < Files.Num())
+	{
+		if (ShouldCancel())
+		{
+			OutError = TEXT("Cancelled");
+			return Abort();
+		}
+
+		if (FileSizes[BatchStart] > MaxBatchedFileSize)
+		{
+			const FString& SourcePath = Files[BatchStart].SourcePath;
+			if (!WriteStreamedEntry(*Writer, SourcePath, FileSizes[BatchStart], ShouldCompress(SourcePath), Compression, CompressionMethodIndex,
+			                        TempPath + TEXT(".blocks"), Entries.AddDefaulted_GetRef(), OutError))
+			{
+				return Abort();
+			}
+
+			++BatchStart;
+			continue;
+		}
+
+		// Group files until the batch is large enough to keep all cores busy
+		int32 BatchEnd = BatchStart;
+		int64 BatchBytes = 0;
+		while (BatchEnd < Files.Num() && FileSizes[BatchEnd] <= MaxBatchedFileSize && (BatchEnd == BatchStart || BatchBytes < BatchSize))
+		{
+			BatchBytes += FileSizes[BatchEnd];
+			++BatchEnd;
+		}
+
+		const FScopedPakMemory Memory(BatchBytes);
+
+		TArray<FPakFileData> Batch;
+		Batch.SetNum(BatchEnd - BatchStart);
+
+		ParallelFor(Batch.Num(), [&](int32 Index)
+		{
+			const FString& SourcePath = Files[BatchStart + Index].SourcePath;
+			Batch[Index].bReadFailed = !FFileHelper::LoadFileToArray(Batch[Index].Uncompressed, *SourcePath);
+			Batch[Index].bSkipCompression = !ShouldCompress(SourcePath);
+		});
+
+		for (int32 Index = 0; Index < Batch.Num(); ++Index)
+		{
+			if (Batch[Index].bReadFailed)
+			{
+				OutError = FString::Printf(TEXT("Failed to read %s"), *Files[BatchStart + Index].SourcePath);
+				return Abort();
+			}
+		}
+
+		if (CompressionMethodIndex != 0)
+		{
+			CompressBatch(Batch, Compression, Cache);
+		}
+
+		for (const FPakFileData& File : Batch)
+		{
+			Entries.Add(WriteEntry(*Writer, File, CompressionMethodIndex, Compression.BlockSize));
+		}
+
+		BatchStart = BatchEnd;
+	}
+
+	FString MountPoint = GetMountPoint(Files);
+	const FString MountRelativeTo = MountPoint.RightChop(FCString::Strlen(TEXT("../../../")));
+
+	TArray<uint8> IndexData;
+	FMemoryWriter IndexWriter(IndexData);
+
+	int32 NumEntries = Entries.Num();
+	IndexWriter << MountPoint;
+	IndexWriter << NumEntries;
+
+	for (int32 Index = 0; Index < Entries.Num(); ++Index)
+	{
+		FString Filename = Files[Index].DestPath.RightChop(MountRelativeTo.Len());
+		IndexWriter << Filename;
+		Entries[Index].Serialize(IndexWriter, PakVersion);
+	}
+
+	Info.Version = PakVersion;
+	Info.IndexOffset = Writer->Tell();
+	Info.IndexSize = IndexData.Num();
+	FSHA1::HashBuffer(IndexData.GetData(), IndexData.Num(), Info.IndexHash.Hash);
+
+	Writer->Serialize(IndexData.GetData(), IndexData.Num());
+	Info.Serialize(*Writer, PakVersion);
+
+	const bool bWriteFailed = Writer->IsError();
+	Writer.Reset();
+
+	if (bWriteFailed)
+	{
+		OutError = FString::Printf(TEXT("Failed to write %s"), *TempPath);
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+		return false;
+	}
+
+	if (!IFileManager::Get().Move(*OutputPath, *TempPath, true, true))
+	{
+		OutError = FString::Printf(TEXT("Failed to replace %s, it might be in use"), *OutputPath);
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+		return false;
+	}
+
+	UE_LOG(LogModdingEx, Log, TEXT("Wrote %d files to %s"), Entries.Num(), *OutputPath);
+	return true;
+}
@@ -259,32 +259,29 @@ void FThunderstore::OnModDownloadComplete(const FHttpResponsePtr& Response, TSha
 		return;
 	}
 
-	const TArray<FZipEntry> Entries = File.GetEntries(Error);
+	// Mods are packaged with the directory in any casing
+	const TArray<FZipIndexEntry> SourceIndexEntries = File.FindEntriesWithPrefixIgnoreCase(TEXT("Sources/"));
 
 	TArray<FSourceEntry> SourceEntries{};
-	for (const FZipEntry& Entry : Entries)
+	for (const FZipIndexEntry& IndexEntry : SourceIndexEntries)
 	{
-		if (!Entry.Name) continue;
-
-		const FString& Name = *Entry.Name;
-		if (!Name.StartsWith("Sources")) continue;
-
+		const FString& Name = IndexEntry.Name;
 		if (Name.Contains(".."))
 		{
 			UE_LOG(LogModdingEx, Warning, TEXT("Skipping potentially malicious entry: %s"), *Name);
 			continue;
 		}
 
-		TArray<uint8> Data = File.ReadEntry(Entry);
-		if (Data.Num() == 0)
+		const TOptional<FZipEntry> Entry = File.GetEntryIndex(IndexEntry.Index, Error);
+		if (!Entry || Entry->DecompressedSize == 0)
 		{
 			continue;
 		}
 
-		const FString DstName = Name.Replace(TEXT("Sources/"), TEXT(""));
+		const FString DstName = Name.RightChop(FCString::Strlen(TEXT("Sources/")));
 		const FString SearchPath = FPaths::SetExtension(FPaths::Combine(TEXT("/Game"), DstName), "");
 
-		SourceEntries.Add(FSourceEntry{DstName, SearchPath, Data});
+		SourceEntries.Add(FSourceEntry{DstName, SearchPath, IndexEntry.Index});
 	}
 
 	if (SourceEntries.IsEmpty())
@@ -309,19 +306,22 @@ void FThunderstore::OnModDownloadComplete(const FHttpResponsePtr& Response, TSha
 		}
 	}
 
-	bool bFailedToSave = false;
+	TArray<FZipExtractEntry> ExtractEntries{};
 	for (const auto& Entry : SourceEntries)
 	{
-		FString DstPath = FPaths::Combine(FPaths::ProjectContentDir(), Entry.Name);
-		if (!FFileHelper::SaveArrayToFile(Entry.Data, *DstPath))
-		{
-			UE_LOG(LogModdingEx, Error, TEXT("Failed to save %s"), *DstPath);
-			bFailedToSave = true;
-		}
+		ExtractEntries.Add({Entry.EntryIndex, FPaths::Combine(FPaths::ProjectContentDir(), Entry.Name)});
 	}
 
-	if (bFailedToSave)
+	const bool bExtracted = File.ExtractEntries(ExtractEntries, [&RequestInfo](int64 BytesWritten, int64 TotalBytes)
 	{
+		RequestInfo->ProgressTask->EnterProgressFrame(0.0f, FText::Format(ThunderstoreLoctext::ExtractingSources,
+		                                                                 FText::AsMemory(BytesWritten), FText::AsMemory(TotalBytes)));
+	}, Error);
+
+	if (!bExtracted)
+	{
+		UE_LOG(LogModdingEx, Error, TEXT("Failed to save some files, error: %d, description: %s"), Error.ErrorCode,
+		       Error.Description ? **Error.Description : TEXT(""));
 		Notifications::ShowFailNotification(ThunderstoreLoctext::FailedToSave);
 	}
 
@@ -1,6 +1,14 @@
 ﻿#include "Zip/ZipFile.h"
 
+#include <atomic>
+
 #include "zip.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/StableSort.h"
+#include "Async/Async.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
 
 FZipError CreateError(const zip_error_t Error)
 {
@@ -15,6 +23,253 @@ FZipError CreateError(const zip_error_t Error)
 }
 
 
+namespace
+{
+	/** Chunk size when entries are streamed */
+	constexpr int64 ReadChunkSize = 256 * 1024;
+
+	/** Reads an entry from its own stream, seeking backwards reopens the stream unless the entry is stored */
+	class FZipEntryReader : public FArchive
+	{
+	public:
+		FZipEntryReader(zip_t* InZip, uint64 InIndex, int64 InSize, FString InName, zip_file_t* InFile) : Zip(InZip), Index(InIndex),
+			Size(InSize), Name(MoveTemp(InName)), File(InFile)
+		{
+			SetIsLoading(true);
+			SetIsPersistent(true);
+		}
+
+		virtual ~FZipEntryReader() override
+		{
+			if (File)
+			{
+				zip_fclose(File);
+			}
+		}
+
+		virtual void Serialize(void* Data, int64 Length) override
+		{
+			if (Length <= 0 || IsError())
+			{
+				return;
+			}
+
+			const zip_int64_t ReadBytes = File ? zip_fread(File, Data, Length) : -1;
+			if (ReadBytes != Length)
+			{
+				SetError();
+				return;
+			}
+
+			Pos += Length;
+		}
+
+		virtual void Seek(int64 InPos) override
+		{
+			if (InPos == Pos || IsError())
+			{
+				return;
+			}
+
+			if (zip_file_is_seekable(File) == 1)
+			{
+				if (zip_fseek(File, InPos, SEEK_SET) != 0)
+				{
+					SetError();
+					return;
+				}
+				Pos = InPos;
+				return;
+			}
+
+			if (InPos < Pos)
+			{
+				zip_fclose(File);
+				File = zip_fopen_index(Zip, Index, 0);
+				Pos = 0;
+				if (!File)
+				{
+					SetError();
+					return;
+				}
+			}
+
+			// Deflated data can only be skipped by decompressing it
+			TArray<uint8> Scratch;
+			Scratch.SetNumUninitialized(FMath::Min<int64>(InPos - Pos, ReadChunkSize));
+			while (Pos < InPos && !IsError())
+			{
+				Serialize(Scratch.GetData(), FMath::Min<int64>(InPos - Pos, Scratch.Num()));
+			}
+		}
+
+		virtual int64 Tell() override { return Pos; }
+
+		virtual int64 TotalSize() override { return Size; }
+
+		virtual FString GetArchiveName() const override { return Name; }
+
+	private:
+		zip_t* Zip;
+		uint64 Index;
+		int64 Size;
+		FString Name;
+
+		zip_file_t* File;
+		int64 Pos = 0;
+	};
+
+	/**
+	 * Copies the reader to the file in chunks
+	 *
+	 * @param BytesWritten Increased after every chunk, if set
+	 */
+	bool ExtractToFile(FArchive& Reader, const FString& Path, std::atomic<int64>* BytesWritten)
+	{
+		const TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+		if (!Writer)
+		{
+			return false;
+		}
+
+		TArray<uint8> Buffer;
+		Buffer.SetNumUninitialized(FMath::Min<int64>(Reader.TotalSize(), ReadChunkSize));
+
+		int64 Remaining = Reader.TotalSize();
+		while (Remaining > 0)
+		{
+			const int64 ChunkSize = FMath::Min<int64>(Remaining, Buffer.Num());
+			Reader.Serialize(Buffer.GetData(), ChunkSize);
+			if (Reader.IsError())
+			{
+				break;
+			}
+
+			Writer->Serialize(Buffer.GetData(), ChunkSize);
+			Remaining -= ChunkSize;
+
+			if (BytesWritten)
+			{
+				*BytesWritten += ChunkSize;
+			}
+		}
+
+		return !Reader.IsError() && Writer->Close();
+	}
+
+	struct FFileHandleSource
+	{
+		TUniquePtr<IFileHandle> Handle;
+		int64 Size = 0;
+		zip_error_t Error{};
+	};
+
+	/** Reads through a platform file handle, for files that can't be mapped */
+	zip_int64_t FileHandleSourceCallback(void* UserData, void* Data, zip_uint64_t Length, zip_source_cmd_t Command)
+	{
+		FFileHandleSource* Source = static_cast<FFileHandleSource*>(UserData);
+
+		switch (Command)
+		{
+		case ZIP_SOURCE_SUPPORTS:
+			return ZIP_SOURCE_SUPPORTS_SEEKABLE;
+
+		case ZIP_SOURCE_OPEN:
+			if (!Source->Handle->Seek(0))
+			{
+				zip_error_set(&Source->Error, ZIP_ER_SEEK, 0);
+				return -1;
+			}
+			return 0;
+
+		case ZIP_SOURCE_READ:
+			{
+				const int64 BytesToRead = FMath::Min<int64>(Length, Source->Size - Source->Handle->Tell());
+				if (BytesToRead > 0 && !Source->Handle->Read(static_cast<uint8*>(Data), BytesToRead))
+				{
+					zip_error_set(&Source->Error, ZIP_ER_READ, 0);
+					return -1;
+				}
+				return FMath::Max<int64>(BytesToRead, 0);
+			}
+
+		case ZIP_SOURCE_CLOSE:
+			return 0;
+
+		case ZIP_SOURCE_STAT:
+			{
+				zip_stat_t* Stat = ZIP_SOURCE_GET_ARGS(zip_stat_t, Data, Length, &Source->Error);
+				if (!Stat)
+				{
+					return -1;
+				}
+
+				Stat->size = Source->Size;
+				Stat->valid |= ZIP_STAT_SIZE;
+				return sizeof(zip_stat_t);
+			}
+
+		case ZIP_SOURCE_SEEK:
+			{
+				const zip_int64_t Offset = zip_source_seek_compute_offset(Source->Handle->Tell(), Source->Size, Data, Length, &Source->Error);
+				if (Offset < 0)
+				{
+					return -1;
+				}
+
+				if (!Source->Handle->Seek(Offset))
+				{
+					zip_error_set(&Source->Error, ZIP_ER_SEEK, 0);
+					return -1;
+				}
+				return 0;
+			}
+
+		case ZIP_SOURCE_TELL:
+			return Source->Handle->Tell();
+
+		case ZIP_SOURCE_ERROR:
+			return zip_error_to_data(&Source->Error, Data, Length);
+
+		case ZIP_SOURCE_FREE:
+			zip_error_fini(&Source->Error);
+			delete Source;
+			return 0;
+
+		default:
+			zip_error_set(&Source->Error, ZIP_ER_OPNOTSUPP, 0);
+			return -1;
+		}
+	}
+
+	bool CreateFileHandleSource(const FString& Path, zip_source_t*& OutSource, FZipError& Error)
+	{
+		FFileHandleSource* HandleSource = new FFileHandleSource();
+		HandleSource->Handle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path));
+		if (!HandleSource->Handle)
+		{
+			delete HandleSource;
+			Error = FZipError{ZIP_ER_OPEN, FString::Printf(TEXT("Failed to open %s"), *Path)};
+			return false;
+		}
+
+		HandleSource->Size = HandleSource->Handle->Size();
+		zip_error_init(&HandleSource->Error);
+
+		zip_error_t ZipError{};
+		OutSource = zip_source_function_create(FileHandleSourceCallback, HandleSource, &ZipError);
+		if (!OutSource)
+		{
+			zip_error_fini(&HandleSource->Error);
+			delete HandleSource;
+			Error = CreateError(ZipError);
+			return false;
+		}
+
+		return true;
+	}
+}
+
 bool FZipBuffer::TryCreateZipBuffer(const TArray<uint8>& Data, FZipBuffer& ZipBuffer, FZipError& Error)
 {
 	zip_error_t ZipError{};
@@ -27,6 +282,73 @@ bool FZipBuffer::TryCreateZipBuffer(const TArray<uint8>& Data, FZipBuffer& ZipBu
 	}
 
 	ZipBuffer = FZipBuffer(Source);
+	ZipBuffer.Data = Data.GetData();
+	ZipBuffer.DataSize = Data.Num();
+	return true;
+}
+
+bool FZipBuffer::TryCreateZipBuffer(const FString& Path, FZipBuffer& ZipBuffer, FZipError& Error)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	zip_error_t ZipError{};
+
+	TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Path));
+	TUniquePtr<IMappedFileRegion> MappedRegion(MappedFile ? MappedFile->MapRegion() : nullptr);
+	if (MappedRegion)
+	{
+		zip_source_t* Source = zip_source_buffer_create(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize(), 0, &ZipError);
+		if (!Source)
+		{
+			Error = CreateError(ZipError);
+			return false;
+		}
+
+		ZipBuffer = FZipBuffer(Source);
+		ZipBuffer.Data = MappedRegion->GetMappedPtr();
+		ZipBuffer.DataSize = MappedRegion->GetMappedSize();
+		ZipBuffer.MappedFile = MoveTemp(MappedFile);
+		ZipBuffer.MappedRegion = MoveTemp(MappedRegion);
+		return true;
+	}
+
+	zip_source_t* Source = nullptr;
+	if (!CreateFileHandleSource(Path, Source, Error))
+	{
+		return false;
+	}
+
+	ZipBuffer = FZipBuffer(Source);
+	ZipBuffer.Path = Path;
+	return true;
+}
+
+bool FZipBuffer::TryDuplicate(FZipBuffer& ZipBuffer, FZipError& Error) const
+{
+	zip_source_t* Source = nullptr;
+	if (Data)
+	{
+		zip_error_t ZipError{};
+		Source = zip_source_buffer_create(Data, DataSize, 0, &ZipError);
+		if (!Source)
+		{
+			Error = CreateError(ZipError);
+			return false;
+		}
+	}
+	else if (Path.IsEmpty())
+	{
+		Error = FZipError{ZIP_ER_INVAL, FString(TEXT("The buffer has nothing to read from"))};
+		return false;
+	}
+	else if (!CreateFileHandleSource(Path, Source, Error))
+	{
+		return false;
+	}
+
+	ZipBuffer = FZipBuffer(Source);
+	ZipBuffer.Data = Data;
+	ZipBuffer.DataSize = DataSize;
+	ZipBuffer.Path = Path;
 	return true;
 }
 
@@ -34,7 +356,7 @@ FZipBuffer::~FZipBuffer()
 {
 	if (Source)
 	{
-		zip_source_close(Source);
+		zip_source_free(Source);
 	}
 }
 
@@ -46,16 +368,36 @@ bool FZipFile::TryCreateZipFile(const TArray<uint8>& Data, FZipFile& ZipFile, FZ
 		return false;
 	}
 
+	return TryCreateZipFile(MoveTemp(Buffer), ZipFile, Error);
+}
+
+bool FZipFile::TryCreateZipFile(const FString& Path, FZipFile& ZipFile, FZipError& Error)
+{
+	FZipBuffer Buffer{};
+	if (!FZipBuffer::TryCreateZipBuffer(Path, Buffer, Error))
+	{
+		return false;
+	}
+
+	return TryCreateZipFile(MoveTemp(Buffer), ZipFile, Error);
+}
+
+bool FZipFile::TryCreateZipFile(FZipBuffer Buffer, FZipFile& ZipFile, FZipError& Error)
+{
 	zip_error_t ZipError{};
 
+	// The zip frees its reference when it is closed, the buffer keeps the source alive until then
+	zip_source_keep(Buffer.Source);
 	zip_t* Zip = zip_open_from_source(Buffer.Source, ZIP_RDONLY, &ZipError);
 	if (!Zip)
 	{
+		zip_source_free(Buffer.Source);
 		Error = CreateError(ZipError);
 		return false;
 	}
 
 	ZipFile = FZipFile(MoveTemp(Buffer), Zip);
+	ZipFile.BuildIndex();
 	return true;
 }
 
@@ -63,25 +405,19 @@ TOptional<FZipEntry> FZipFile::GetEntry(const FString& Name, FZipError& Error) c
 {
 	if (!Zip) return NullOpt;
 
-	const int64 EntryIndex = zip_name_locate(Zip, TCHAR_TO_ANSI(*Name), 0);
-	if (EntryIndex == -1)
+	const TOptional<uint64> EntryIndex = FindEntryIndex(Name);
+	if (!EntryIndex)
 	{
 		return NullOpt;
 	}
 
-	return GetEntryIndex(EntryIndex, Error);
+	return GetEntryIndex(*EntryIndex, Error);
 }
 
 TOptional<FZipEntry> FZipFile::GetEntryIndex(uint64 Index, FZipError& Error) const
 {
 	zip_stat_t EntryStat{};
 	if (zip_stat_index(Zip, Index, 0, &EntryStat) != 0)
-	{
-		return NullOpt;
-	}
-
-	zip_file* File = zip_fopen_index(Zip, Index, 0);
-	if (!File)
 	{
 		const zip_error_t* ZipError = zip_get_error(Zip);
 		Error = CreateError(*ZipError);
@@ -91,12 +427,13 @@ TOptional<FZipEntry> FZipFile::GetEntryIndex(uint64 Index, FZipError& Error) con
 	FZipEntry Entry{};
 	if (EntryStat.name)
 	{
-		Entry.Name = FString(EntryStat.name);
+		Entry.Name = FString(UTF8_TO_TCHAR(EntryStat.name));
 	}
 	Entry.Index = Index;
 	Entry.DecompressedSize = EntryStat.size;
 	Entry.CompressedSize = EntryStat.comp_size;
-	Entry.File = File;
+	Entry.Crc = EntryStat.crc;
+	Entry.CompressionMethod = EntryStat.comp_method;
 
 	return Entry;
 }
@@ -128,16 +465,107 @@ TArray<FZipEntry> FZipFile::GetEntries(FZipError& Error) const
 	return Entries;
 }
 
+TOptional<uint64> FZipFile::FindEntryIndex(const FString& Name) const
+{
+	const int32* Position = EntryLookup.Find(Name);
+	if (!Position)
+	{
+		return NullOpt;
+	}
+
+	return SortedEntries[*Position].Index;
+}
+
+TArrayView<const FZipIndexEntry> FZipFile::FindEntriesWithPrefix(FStringView Prefix) const
+{
+	// Cutting the sorted names to the length of the prefix keeps them sorted, so both ends can be binary searched
+	auto CompareToPrefix = [Prefix](const FZipIndexEntry& Entry)
+	{
+		return FMath::Sign(FStringView(Entry.Name).Left(Prefix.Len()).Compare(Prefix, ESearchCase::CaseSensitive));
+	};
+
+	const int32 First = Algo::LowerBoundBy(SortedEntries, 0, CompareToPrefix);
+	const int32 Last = Algo::UpperBoundBy(SortedEntries, 0, CompareToPrefix);
 
-TArray<uint8> FZipFile::ReadEntry(const FZipEntry& Entry) const
+	return TArrayView<const FZipIndexEntry>(SortedEntries.GetData() + First, Last - First);
+}
+
+TArray<FZipIndexEntry> FZipFile::FindEntriesWithPrefixIgnoreCase(FStringView Prefix) const
+{
+	auto CompareToPrefix = [this, Prefix](int32 Position)
+	{
+		return FMath::Sign(FStringView(SortedEntries[Position].Name).Left(Prefix.Len()).Compare(Prefix, ESearchCase::IgnoreCase));
+	};
+
+	const int32 First = Algo::LowerBoundBy(SortedIgnoreCase, 0, CompareToPrefix);
+	const int32 Last = Algo::UpperBoundBy(SortedIgnoreCase, 0, CompareToPrefix);
+
+	TArray<FZipIndexEntry> Entries;
+	Entries.Reserve(Last - First);
+	for (int32 Position = First; Position < Last; ++Position)
+	{
+		Entries.Add(SortedEntries[SortedIgnoreCase[Position]]);
+	}
+
+	return Entries;
+}
+
+void FZipFile::BuildIndex()
 {
-	if (!Zip) return {};
+	SortedEntries.Reset();
+	EntryLookup.Reset();
+	SortedIgnoreCase.Reset();
+
+	const int64 NumEntries = zip_get_num_entries(Zip, 0);
+	SortedEntries.Reserve(NumEntries);
+
+	for (int64 EntryIndex = 0; EntryIndex < NumEntries; EntryIndex++)
+	{
+		// Only reads the central directory, deleted entries have no name
+		if (const char* Name = zip_get_name(Zip, EntryIndex, 0))
+		{
+			SortedEntries.Add({FString(UTF8_TO_TCHAR(Name)), static_cast<uint64>(EntryIndex)});
+		}
+	}
+
+	SortedEntries.Sort([](const FZipIndexEntry& A, const FZipIndexEntry& B)
+	{
+		return A.Name.Compare(B.Name, ESearchCase::CaseSensitive) < 0;
+	});
+
+	EntryLookup.Reserve(SortedEntries.Num());
+	for (int32 Position = 0; Position < SortedEntries.Num(); ++Position)
+	{
+		// Keep the first of duplicate names like zip_name_locate did
+		if (const int32* Existing = EntryLookup.Find(SortedEntries[Position].Name))
+		{
+			if (SortedEntries[*Existing].Index < SortedEntries[Position].Index)
+			{
+				continue;
+			}
+		}
+		EntryLookup.Add(SortedEntries[Position].Name, Position);
+	}
+
+	SortedIgnoreCase.SetNumUninitialized(SortedEntries.Num());
+	for (int32 Position = 0; Position < SortedEntries.Num(); ++Position)
+	{
+		SortedIgnoreCase[Position] = Position;
+	}
 
+	// Stable so names that only differ in case keep their case sensitive order
+	Algo::StableSort(SortedIgnoreCase, [this](int32 A, int32 B)
+	{
+		return SortedEntries[A].Name.Compare(SortedEntries[B].Name, ESearchCase::IgnoreCase) < 0;
+	});
+}
+
+TArray<uint8> FZipFile::ReadEntry(const FZipEntry& Entry) const
+{
 	TArray<uint8> Array{};
-	Array.Init(0, Entry.DecompressedSize);
+	Array.SetNumUninitialized(Entry.DecompressedSize);
 
-	const int64 ReadBytes = zip_fread(Entry.File, Array.GetData(), Entry.DecompressedSize);
-	if (ReadBytes == -1)
+	if (!ReadEntryInto(Entry, Array))
 	{
 		return {};
 	}
@@ -145,6 +573,150 @@ TArray<uint8> FZipFile::ReadEntry(const FZipEntry& Entry) const
 	return Array;
 }
 
+bool FZipFile::ReadEntryInto(const FZipEntry& Entry, TArrayView64<uint8> Destination) const
+{
+	if (!Zip || Destination.Num() != static_cast<int64>(Entry.DecompressedSize)) return false;
+
+	if (!Entry.File)
+	{
+		Entry.File = zip_fopen_index(Zip, Entry.Index, 0);
+		if (!Entry.File)
+		{
+			return false;
+		}
+	}
+
+	// zip_fread can return less than asked for without failing
+	int64 TotalRead = 0;
+	while (TotalRead < Destination.Num())
+	{
+		const zip_int64_t ReadBytes = zip_fread(Entry.File, Destination.GetData() + TotalRead, Destination.Num() - TotalRead);
+		if (ReadBytes <= 0)
+		{
+			break;
+		}
+		TotalRead += ReadBytes;
+	}
+
+	// The stream is at its end, the next read opens a new one
+	zip_fclose(Entry.File);
+	Entry.File = nullptr;
+
+	return TotalRead == Destination.Num();
+}
+
+TUniquePtr<FArchive> FZipFile::CreateEntryReader(const FZipEntry& Entry) const
+{
+	if (!Zip) return nullptr;
+
+	zip_file_t* File = zip_fopen_index(Zip, Entry.Index, 0);
+	if (!File)
+	{
+		return nullptr;
+	}
+
+	return MakeUnique<FZipEntryReader>(Zip, Entry.Index, Entry.DecompressedSize, Entry.Name.Get(FString()), File);
+}
+
+bool FZipFile::ExtractEntry(const FZipEntry& Entry, const FString& Path) const
+{
+	const TUniquePtr<FArchive> Reader = CreateEntryReader(Entry);
+	return Reader && ExtractToFile(*Reader, Path, nullptr);
+}
+
+bool FZipFile::ExtractEntries(const TArray<FZipExtractEntry>& Entries, TFunctionRef<void(int64, int64)> OnProgress, FZipError& Error) const
+{
+	if (!Zip) return false;
+
+	int64 TotalBytes = 0;
+	for (const FZipExtractEntry& Entry : Entries)
+	{
+		zip_stat_t EntryStat{};
+		if (zip_stat_index(Zip, Entry.Index, 0, &EntryStat) == 0)
+		{
+			TotalBytes += EntryStat.size;
+		}
+	}
+
+	std::atomic<int32> NextEntry = 0;
+	std::atomic<int64> BytesWritten = 0;
+
+	FCriticalSection ErrorLock;
+	bool bFailed = false;
+
+	auto SetError = [&ErrorLock, &bFailed, &Error](const FZipError& WorkerError)
+	{
+		FScopeLock ScopeLock(&ErrorLock);
+		if (!bFailed)
+		{
+			Error = WorkerError;
+			bFailed = true;
+		}
+	};
+
+	// A zip_t can't be shared between threads, every worker reads through its own one on the same data
+	auto Worker = [this, &Entries, &NextEntry, &BytesWritten, &SetError]
+	{
+		FZipBuffer WorkerBuffer{};
+		FZipError WorkerError{};
+		if (!Buffer.TryDuplicate(WorkerBuffer, WorkerError))
+		{
+			SetError(WorkerError);
+			return;
+		}
+
+		zip_error_t ZipError{};
+		zip_source_keep(WorkerBuffer.Source);
+		zip_t* WorkerZip = zip_open_from_source(WorkerBuffer.Source, ZIP_RDONLY, &ZipError);
+		if (!WorkerZip)
+		{
+			zip_source_free(WorkerBuffer.Source);
+			SetError(CreateError(ZipError));
+			return;
+		}
+
+		for (int32 EntryIndex = NextEntry++; EntryIndex < Entries.Num(); EntryIndex = NextEntry++)
+		{
+			const FZipExtractEntry& Entry = Entries[EntryIndex];
+
+			zip_stat_t EntryStat{};
+			zip_file_t* File = zip_stat_index(WorkerZip, Entry.Index, 0, &EntryStat) == 0 ? zip_fopen_index(WorkerZip, Entry.Index, 0) : nullptr;
+			if (!File)
+			{
+				SetError(CreateError(*zip_get_error(WorkerZip)));
+				continue;
+			}
+
+			FZipEntryReader Reader(WorkerZip, Entry.Index, EntryStat.size, Entry.Path, File);
+			if (!ExtractToFile(Reader, Entry.Path, &BytesWritten))
+			{
+				SetError(FZipError{ZIP_ER_WRITE, FString::Printf(TEXT("Failed to extract %s"), *Entry.Path)});
+			}
+		}
+
+		zip_close(WorkerZip);
+	};
+
+	const int32 NumWorkers = FMath::Clamp(FTaskGraphInterface::Get().GetNumWorkerThreads(), 1, Entries.Num());
+
+	TArray<TFuture<void>> Workers;
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; ++WorkerIndex)
+	{
+		Workers.Add(Async(EAsyncExecution::ThreadPool, Worker));
+	}
+
+	// Progress is reported from the calling thread, so it can update UI
+	for (const TFuture<void>& Future : Workers)
+	{
+		while (!Future.WaitFor(FTimespan::FromMilliseconds(50)))
+		{
+			OnProgress(BytesWritten, TotalBytes);
+		}
+	}
+	OnProgress(BytesWritten, TotalBytes);
+
+	return !bFailed;
+}
 
 FZipFile::~FZipFile()
 {
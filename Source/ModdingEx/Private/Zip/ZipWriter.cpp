@@ -0,0 +1,720 @@
+﻿#include "Zip/ZipWriter.h"
+
+#include "zip.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Compression.h"
+#include "Misc/Crc.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
+#include "Serialization/MemoryWriter.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+namespace
+{
+	/** Size of each sample taken by IsWorthCompressing */
+	constexpr int64 ProbeSampleSize = 64 * 1024;
+
+	constexpr int32 ProbeSampleCount = 3;
+
+	/** Samples that don't get below this fraction of their size are stored */
+	constexpr double MinCompressionRatio = 0.9;
+
+	zip_source_t* CreateFileSource(const FString& Path, zip_error_t* Error)
+	{
+#if PLATFORM_WINDOWS
+		// The wide version handles paths outside of the ANSI code page
+		return zip_source_win32w_create(*Path, 0, ZIP_LENGTH_TO_END, Error);
+#else
+		return zip_source_file_create(TCHAR_TO_UTF8(*Path), 0, ZIP_LENGTH_TO_END, Error);
+#endif
+	}
+
+	/** Set explicitly instead of relying on the libzip default so the output doesn't change with the library */
+	constexpr zip_uint32_t DeflateLevel = 6;
+
+	/** 1980-01-01 00:00, set as DOS time so it doesn't depend on the time zone */
+	constexpr zip_uint16_t DeterministicDosTime = 0;
+	constexpr zip_uint16_t DeterministicDosDate = (0 << 9) | (1 << 5) | 1;
+
+	/** Regular file, rw-r--r-- */
+	constexpr zip_uint32_t DeterministicAttributes = 0100644u << 16;
+
+	/** Files are split into chunks of this size that are deflated in parallel and joined into a single deflate stream */
+	constexpr int64 DeflateChunkSize = 4 * 1024 * 1024;
+
+	/** How many chunks of a file are deflated at once */
+	constexpr int32 DeflateChunksPerBatch = 8;
+
+	/** zlib looks back this far, priming a chunk with the end of the previous one keeps the ratio of a single stream */
+	constexpr int64 DeflateDictionarySize = 32 * 1024;
+
+	/** Deflated data of larger entries goes to a temporary file instead of memory */
+	constexpr int64 MaxInMemoryEntrySize = 64 * 1024 * 1024;
+
+	/** How much input is deflated ahead of the entry that is being written */
+	constexpr int64 DeflateWindowSize = 256 * 1024 * 1024;
+
+	struct FDeflatedChunk
+	{
+		TArray<uint8> Data;
+		uint32 Crc = 0;
+		int64 Size = 0;
+		bool bSucceeded = false;
+	};
+
+	/**
+	 * Deflates one chunk of the file to raw deflate data.
+	 * Every chunk but the last ends with a sync flush instead of a final block, so the chunks can be concatenated as they are.
+	 */
+	void DeflateChunk(const FString& SourcePath, int64 FileSize, int64 ChunkIndex, bool bLastChunk, FDeflatedChunk& OutChunk)
+	{
+		const int64 Offset = ChunkIndex * DeflateChunkSize;
+		const int64 DictionarySize = FMath::Min(Offset, DeflateDictionarySize);
+		OutChunk.Size = FMath::Min(DeflateChunkSize, FileSize - Offset);
+
+		const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*SourcePath));
+		if (!Reader)
+		{
+			return;
+		}
+
+		TArray<uint8> Input;
+		Input.SetNumUninitialized(DictionarySize + OutChunk.Size);
+		Reader->Seek(Offset - DictionarySize);
+		Reader->Serialize(Input.GetData(), Input.Num());
+		if (Reader->IsError())
+		{
+			return;
+		}
+
+		uint8* ChunkData = Input.GetData() + DictionarySize;
+		OutChunk.Crc = crc32(0, ChunkData, static_cast<uInt>(OutChunk.Size));
+
+		z_stream Stream{};
+		if (deflateInit2(&Stream, static_cast<int>(DeflateLevel), Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			return;
+		}
+		ON_SCOPE_EXIT { deflateEnd(&Stream); };
+
+		if (DictionarySize > 0 && deflateSetDictionary(&Stream, Input.GetData(), static_cast<uInt>(DictionarySize)) != Z_OK)
+		{
+			return;
+		}
+
+		// The bound doesn't include the marker of the sync flush
+		OutChunk.Data.SetNumUninitialized(deflateBound(&Stream, static_cast<uLong>(OutChunk.Size)) + 64);
+		Stream.next_in = ChunkData;
+		Stream.avail_in = static_cast<uInt>(OutChunk.Size);
+		Stream.next_out = OutChunk.Data.GetData();
+		Stream.avail_out = static_cast<uInt>(OutChunk.Data.Num());
+
+		const int32 Result = deflate(&Stream, bLastChunk ? Z_FINISH : Z_SYNC_FLUSH);
+		if (Result != (bLastChunk ? Z_STREAM_END : Z_OK) || Stream.avail_in != 0 || Stream.avail_out == 0)
+		{
+			return;
+		}
+
+		OutChunk.Data.SetNum(Stream.total_out, false);
+		OutChunk.bSucceeded = true;
+	}
+
+	/** Deflates the file to a raw deflate stream, a batch of chunks at a time so memory use doesn't depend on the file size */
+	bool DeflateFile(const FString& SourcePath, int64 FileSize, FArchive& Output, uint32& OutCrc, FZipError& Error)
+	{
+		const int64 NumChunks = FMath::Max<int64>(1, FMath::DivideAndRoundUp(FileSize, DeflateChunkSize));
+
+		uint32 Crc = 0;
+		TArray<FDeflatedChunk> Chunks;
+		for (int64 FirstChunk = 0; FirstChunk < NumChunks; FirstChunk += DeflateChunksPerBatch)
+		{
+			Chunks.Reset();
+			Chunks.SetNum(static_cast<int32>(FMath::Min<int64>(DeflateChunksPerBatch, NumChunks - FirstChunk)));
+
+			ParallelFor(Chunks.Num(), [&](int32 Index)
+			{
+				const int64 ChunkIndex = FirstChunk + Index;
+				DeflateChunk(SourcePath, FileSize, ChunkIndex, ChunkIndex == NumChunks - 1, Chunks[Index]);
+			});
+
+			for (const FDeflatedChunk& Chunk : Chunks)
+			{
+				if (!Chunk.bSucceeded)
+				{
+					Error = FZipError{ZIP_ER_READ, FString::Printf(TEXT("Failed to deflate %s"), *SourcePath)};
+					return false;
+				}
+
+				Output.Serialize(const_cast<uint8*>(Chunk.Data.GetData()), Chunk.Data.Num());
+				Crc = crc32_combine(Crc, Chunk.Crc, static_cast<z_off_t>(Chunk.Size));
+			}
+		}
+
+		if (Output.IsError())
+		{
+			Error = FZipError{ZIP_ER_WRITE, FString::Printf(TEXT("Failed to write the deflated data of %s"), *SourcePath)};
+			return false;
+		}
+
+		OutCrc = Crc;
+		return true;
+	}
+}
+
+struct FZipDeflatedEntry
+{
+	FString SourcePath;
+	int64 Size = 0;
+	time_t ModificationTime = 0;
+
+	TFuture<void> Task;
+
+	bool bSucceeded = false;
+	FZipError Error{};
+	uint32 Crc = 0;
+	uint64 DeflatedSize = 0;
+
+	/** Deflated data of entries up to MaxInMemoryEntrySize */
+	TArray<uint8> Data;
+
+	/** Temporary file with the deflated data of larger entries */
+	FString SpillPath;
+
+	~FZipDeflatedEntry()
+	{
+		if (!SpillPath.IsEmpty())
+		{
+			IFileManager::Get().Delete(*SpillPath, false, false, true);
+		}
+	}
+};
+
+/**
+ * Deflates entries on the thread pool ahead of libzip writing them.
+ * libzip writes entries one after another, so the entries following the one it asks for are started as long as they fit
+ * in the window. The zip itself is still written in entry order, only the deflating happens in parallel, for large
+ * entries also within the entry.
+ */
+class FZipDeflateQueue : public TSharedFromThis<FZipDeflateQueue>
+{
+public:
+	int32 Add(const FString& SourcePath, int64 Size, time_t ModificationTime)
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		TUniquePtr<FZipDeflatedEntry>& Entry = Entries.Add_GetRef(MakeUnique<FZipDeflatedEntry>());
+		Entry->SourcePath = SourcePath;
+		Entry->Size = Size;
+		Entry->ModificationTime = ModificationTime;
+		return Entries.Num() - 1;
+	}
+
+	/** Starts the entry and the ones after it that fit in the window and waits for the entry */
+	FZipDeflatedEntry& Wait(int32 Slot)
+	{
+		FZipDeflatedEntry* Entry;
+		{
+			FScopeLock ScopeLock(&Lock);
+
+			int64 WindowSize = 0;
+			for (int32 Index = Slot; Index < Entries.Num(); ++Index)
+			{
+				WindowSize += Entries[Index]->Size;
+				if (Index > Slot && WindowSize > DeflateWindowSize)
+				{
+					break;
+				}
+
+				Start(*Entries[Index]);
+			}
+
+			Entry = Entries[Slot].Get();
+		}
+
+		Entry->Task.Wait();
+		return *Entry;
+	}
+
+private:
+	void Start(FZipDeflatedEntry& Entry)
+	{
+		if (Entry.Task.IsValid())
+		{
+			return;
+		}
+
+		Entry.Task = Async(EAsyncExecution::ThreadPool, [Self = AsShared(), &Entry]
+		{
+			if (Entry.Size <= MaxInMemoryEntrySize)
+			{
+				FMemoryWriter Writer(Entry.Data);
+				Entry.bSucceeded = DeflateFile(Entry.SourcePath, Entry.Size, Writer, Entry.Crc, Entry.Error);
+				Entry.DeflatedSize = Entry.Data.Num();
+				return;
+			}
+
+			Entry.SpillPath = FPaths::CreateTempFilename(FPlatformProcess::UserTempDir(), TEXT("ModdingExZip"), TEXT(".deflate"));
+			const TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Entry.SpillPath));
+			if (!Writer)
+			{
+				Entry.Error = FZipError{ZIP_ER_TMPOPEN, FString::Printf(TEXT("Failed to create %s"), *Entry.SpillPath)};
+				return;
+			}
+
+			Entry.bSucceeded = DeflateFile(Entry.SourcePath, Entry.Size, *Writer, Entry.Crc, Entry.Error);
+			Entry.DeflatedSize = Writer->Tell();
+			if (!Writer->Close() && Entry.bSucceeded)
+			{
+				Entry.bSucceeded = false;
+				Entry.Error = FZipError{ZIP_ER_WRITE, FString::Printf(TEXT("Failed to write %s"), *Entry.SpillPath)};
+			}
+		});
+	}
+
+private:
+	FCriticalSection Lock;
+	TArray<TUniquePtr<FZipDeflatedEntry>> Entries;
+};
+
+namespace
+{
+	struct FDeflatedSource
+	{
+		TSharedPtr<FZipDeflateQueue> Queue;
+		int32 Slot = 0;
+		uint64 Offset = 0;
+		zip_error_t Error{};
+
+		/** Open while a spilled entry is being written */
+		TUniquePtr<FArchive> SpillReader;
+	};
+
+	/** Hands libzip the deflated data together with its crc, so it is copied to the zip as is instead of being compressed again */
+	zip_int64_t DeflatedSourceCallback(void* UserData, void* Data, zip_uint64_t Length, zip_source_cmd_t Command)
+	{
+		FDeflatedSource* Source = static_cast<FDeflatedSource*>(UserData);
+
+		switch (Command)
+		{
+		case ZIP_SOURCE_SUPPORTS:
+			return ZIP_SOURCE_SUPPORTS_READABLE;
+
+		case ZIP_SOURCE_STAT:
+			{
+				zip_stat_t* Stat = ZIP_SOURCE_GET_ARGS(zip_stat_t, Data, Length, &Source->Error);
+				if (!Stat)
+				{
+					return -1;
+				}
+
+				const FZipDeflatedEntry& Entry = Source->Queue->Wait(Source->Slot);
+				if (!Entry.bSucceeded)
+				{
+					zip_error_set(&Source->Error, Entry.Error.ErrorCode, 0);
+					return -1;
+				}
+
+				Stat->size = Entry.Size;
+				Stat->comp_size = Entry.DeflatedSize;
+				Stat->crc = Entry.Crc;
+				Stat->mtime = Entry.ModificationTime;
+				Stat->comp_method = ZIP_CM_DEFLATE;
+				Stat->encryption_method = ZIP_EM_NONE;
+				Stat->valid |= ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE | ZIP_STAT_CRC | ZIP_STAT_MTIME | ZIP_STAT_COMP_METHOD |
+					ZIP_STAT_ENCRYPTION_METHOD;
+				return sizeof(zip_stat_t);
+			}
+
+		case ZIP_SOURCE_OPEN:
+			{
+				const FZipDeflatedEntry& Entry = Source->Queue->Wait(Source->Slot);
+				if (!Entry.bSucceeded)
+				{
+					zip_error_set(&Source->Error, Entry.Error.ErrorCode, 0);
+					return -1;
+				}
+
+				if (!Entry.SpillPath.IsEmpty())
+				{
+					Source->SpillReader.Reset(IFileManager::Get().CreateFileReader(*Entry.SpillPath));
+					if (!Source->SpillReader)
+					{
+						zip_error_set(&Source->Error, ZIP_ER_OPEN, 0);
+						return -1;
+					}
+				}
+
+				Source->Offset = 0;
+				return 0;
+			}
+
+		case ZIP_SOURCE_READ:
+			{
+				FZipDeflatedEntry& Entry = Source->Queue->Wait(Source->Slot);
+				const uint64 BytesToCopy = FMath::Min<uint64>(Length, Entry.DeflatedSize - Source->Offset);
+				if (Source->SpillReader)
+				{
+					Source->SpillReader->Serialize(Data, BytesToCopy);
+					if (Source->SpillReader->IsError())
+					{
+						zip_error_set(&Source->Error, ZIP_ER_READ, 0);
+						return -1;
+					}
+				}
+				else
+				{
+					FMemory::Memcpy(Data, Entry.Data.GetData() + Source->Offset, BytesToCopy);
+				}
+				Source->Offset += BytesToCopy;
+				return BytesToCopy;
+			}
+
+		case ZIP_SOURCE_CLOSE:
+			{
+				// Written, only the stat is still needed
+				FZipDeflatedEntry& Entry = Source->Queue->Wait(Source->Slot);
+				Entry.Data.Empty();
+				Source->SpillReader.Reset();
+				return 0;
+			}
+
+		case ZIP_SOURCE_ERROR:
+			return zip_error_to_data(&Source->Error, Data, Length);
+
+		case ZIP_SOURCE_FREE:
+			zip_error_fini(&Source->Error);
+			delete Source;
+			return 0;
+
+		default:
+			zip_error_set(&Source->Error, ZIP_ER_OPNOTSUPP, 0);
+			return -1;
+		}
+	}
+}
+
+struct FZipUpdateFile
+{
+	FString EntryName;
+	FString SourcePath;
+	EZipCompression Compression;
+};
+
+struct FZipUpdateState
+{
+	FString Path;
+
+	/** Entries at and above this index were added by the writer */
+	zip_int64_t OriginalEntryCount = 0;
+
+	TSet<zip_int64_t> AddedEntries;
+	zip_int64_t LastIndex = -1;
+
+	/** Every file was added after the ones before it in the zip */
+	bool bKeepsOrder = true;
+
+	/** Everything that was added, to write a fresh zip if the order changed */
+	TArray<FZipUpdateFile> Files;
+};
+
+bool FZipWriter::TryCreateZipWriter(const FString& Path, FZipWriter& Writer, FZipError& Error)
+{
+	zip_error_t ZipError{};
+	zip_error_init(&ZipError);
+
+	zip_source_t* Source = CreateFileSource(Path, &ZipError);
+	if (!Source)
+	{
+		Error = CreateError(ZipError);
+		zip_error_fini(&ZipError);
+		return false;
+	}
+
+	// Writes to a temporary file next to the target that replaces it on close
+	zip_t* Zip = zip_open_from_source(Source, ZIP_CREATE | ZIP_TRUNCATE, &ZipError);
+	if (!Zip)
+	{
+		zip_source_free(Source);
+		Error = CreateError(ZipError);
+		zip_error_fini(&ZipError);
+		return false;
+	}
+
+	Writer = FZipWriter(Zip);
+	return true;
+}
+
+bool FZipWriter::TryUpdateZipWriter(const FString& Path, FZipWriter& Writer, FZipError& Error)
+{
+	zip_error_t ZipError{};
+	zip_error_init(&ZipError);
+
+	zip_source_t* Source = CreateFileSource(Path, &ZipError);
+	if (!Source)
+	{
+		Error = CreateError(ZipError);
+		zip_error_fini(&ZipError);
+		return false;
+	}
+
+	zip_t* Zip = zip_open_from_source(Source, ZIP_CREATE | ZIP_CHECKCONS, &ZipError);
+	if (!Zip)
+	{
+		zip_source_free(Source);
+		Error = CreateError(ZipError);
+		zip_error_fini(&ZipError);
+		return false;
+	}
+
+	Writer = FZipWriter(Zip);
+	Writer.UpdateState = MakeShared<FZipUpdateState>();
+	Writer.UpdateState->Path = Path;
+	Writer.UpdateState->OriginalEntryCount = zip_get_num_entries(Zip, 0);
+	return true;
+}
+
+bool FZipWriter::IsWorthCompressing(const FString& SourcePath)
+{
+	const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*SourcePath));
+	if (!Reader)
+	{
+		// Let adding the file report the error
+		return true;
+	}
+
+	const int64 FileSize = Reader->TotalSize();
+	if (FileSize <= ProbeSampleSize * ProbeSampleCount)
+	{
+		// Small files are cheap to deflate either way
+		return true;
+	}
+
+	TArray<uint8> Sample;
+	Sample.SetNumUninitialized(ProbeSampleSize);
+
+	TArray<uint8> Compressed;
+	Compressed.SetNumUninitialized(FCompression::CompressMemoryBound(NAME_Zlib, ProbeSampleSize));
+
+	int64 TotalCompressed = 0;
+	for (int32 SampleIndex = 0; SampleIndex < ProbeSampleCount; ++SampleIndex)
+	{
+		// Spread over the file so a compressible header doesn't decide for the whole file
+		Reader->Seek((FileSize - ProbeSampleSize) * SampleIndex / (ProbeSampleCount - 1));
+		Reader->Serialize(Sample.GetData(), ProbeSampleSize);
+
+		int32 CompressedSize = Compressed.Num();
+		if (!FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, Sample.GetData(), ProbeSampleSize))
+		{
+			CompressedSize = ProbeSampleSize;
+		}
+		TotalCompressed += CompressedSize;
+	}
+
+	return TotalCompressed < ProbeSampleSize * ProbeSampleCount * MinCompressionRatio;
+}
+
+bool FZipWriter::AddFile(const FString& EntryName, const FString& SourcePath, EZipCompression Compression, FZipError& Error)
+{
+	if (!Zip) return false;
+
+	const FFileStatData FileStat = IFileManager::Get().GetStatData(*SourcePath);
+	const bool bDeflatedUpFront = Compression == EZipCompression::Deflate && FileStat.bIsValid;
+
+	// Unchanged entries of an updated zip keep their compressed data, libzip copies it as is
+	zip_int64_t Index = UpdateState ? zip_name_locate(Zip, TCHAR_TO_UTF8(*EntryName), 0) : -1;
+	const bool bUnchanged = Index >= 0 && Index < UpdateState->OriginalEntryCount && IsSameFile(Index, SourcePath, FileStat.FileSize);
+
+	if (!bUnchanged)
+	{
+		zip_error_t ZipError{};
+		zip_error_init(&ZipError);
+
+		zip_source_t* Source = nullptr;
+		if (bDeflatedUpFront)
+		{
+			// A file that can't be read would only fail once the zip is written and take the whole zip down with it
+			if (!TUniquePtr<FArchive>(IFileManager::Get().CreateFileReader(*SourcePath)))
+			{
+				Error = FZipError{ZIP_ER_OPEN, FString::Printf(TEXT("Can't read %s"), *SourcePath)};
+				zip_error_fini(&ZipError);
+				return false;
+			}
+
+			if (!DeflateQueue)
+			{
+				DeflateQueue = MakeShared<FZipDeflateQueue>();
+			}
+
+			FDeflatedSource* DeflatedSource = new FDeflatedSource();
+			DeflatedSource->Queue = DeflateQueue;
+			DeflatedSource->Slot = DeflateQueue->Add(SourcePath, FileStat.FileSize, FileStat.ModificationTime.ToUnixTimestamp());
+			zip_error_init(&DeflatedSource->Error);
+
+			Source = zip_source_function_create(DeflatedSourceCallback, DeflatedSource, &ZipError);
+			if (!Source)
+			{
+				zip_error_fini(&DeflatedSource->Error);
+				delete DeflatedSource;
+			}
+		}
+		else
+		{
+			Source = CreateFileSource(SourcePath, &ZipError);
+		}
+
+		if (!Source)
+		{
+			Error = CreateError(ZipError);
+			zip_error_fini(&ZipError);
+			return false;
+		}
+
+		Index = zip_file_add(Zip, TCHAR_TO_UTF8(*EntryName), Source, ZIP_FL_ENC_UTF_8 | ZIP_FL_OVERWRITE);
+		if (Index < 0)
+		{
+			zip_source_free(Source);
+			Error = CreateError(*zip_get_error(Zip));
+			return false;
+		}
+	}
+
+	// Entries deflated up front already carry their compression method, for kept entries libzip only recompresses if the method changes
+	const bool bSetCompression = Compression == EZipCompression::Store
+		                             ? zip_set_file_compression(Zip, Index, ZIP_CM_STORE, 0) == 0
+		                             : (bDeflatedUpFront && !bUnchanged) || zip_set_file_compression(Zip, Index, ZIP_CM_DEFLATE, DeflateLevel) == 0;
+
+	// The source file's timestamp and permissions differ between checkouts
+	const bool bSetMetadata = !bDeterministic ||
+		(zip_file_set_dostime(Zip, Index, DeterministicDosTime, DeterministicDosDate, 0) == 0 &&
+			zip_file_set_external_attributes(Zip, Index, 0, ZIP_OPSYS_UNIX, DeterministicAttributes) == 0);
+
+	if (!bSetCompression || !bSetMetadata)
+	{
+		Error = CreateError(*zip_get_error(Zip));
+		if (!bUnchanged)
+		{
+			zip_delete(Zip, Index);
+		}
+		return false;
+	}
+
+	if (UpdateState)
+	{
+		// libzip writes entries by index, kept entries stay where they were and new ones are appended
+		UpdateState->bKeepsOrder &= Index > UpdateState->LastIndex;
+		UpdateState->LastIndex = Index;
+		UpdateState->AddedEntries.Add(Index);
+		UpdateState->Files.Add({EntryName, SourcePath, Compression});
+	}
+
+	return true;
+}
+
+bool FZipWriter::Close(FZipError& Error)
+{
+	if (!Zip) return false;
+
+	if (UpdateState)
+	{
+		if (bDeterministic && !UpdateState->bKeepsOrder)
+		{
+			return Rebuild(Error);
+		}
+
+		// Whatever wasn't added again is gone from the staged files
+		for (zip_int64_t Index = 0; Index < UpdateState->OriginalEntryCount; ++Index)
+		{
+			if (!UpdateState->AddedEntries.Contains(Index))
+			{
+				zip_delete(Zip, Index);
+			}
+		}
+	}
+
+	if (zip_close(Zip) != 0)
+	{
+		Error = CreateError(*zip_get_error(Zip));
+		zip_discard(Zip);
+		Zip = nullptr;
+		return false;
+	}
+
+	Zip = nullptr;
+	return true;
+}
+
+bool FZipWriter::IsSameFile(zip_int64_t Index, const FString& SourcePath, int64 Size) const
+{
+	zip_stat_t Stat{};
+	if (zip_stat_index(Zip, Index, 0, &Stat) != 0 || (Stat.valid & (ZIP_STAT_SIZE | ZIP_STAT_CRC)) != (ZIP_STAT_SIZE | ZIP_STAT_CRC))
+	{
+		return false;
+	}
+
+	if (Size < 0 || Stat.size != static_cast<zip_uint64_t>(Size))
+	{
+		return false;
+	}
+
+	const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*SourcePath));
+	if (!Reader)
+	{
+		return false;
+	}
+
+	TArray<uint8> Buffer;
+	Buffer.SetNumUninitialized(256 * 1024);
+
+	uint32 Crc = 0;
+	int64 Remaining = Reader->TotalSize();
+	while (Remaining > 0)
+	{
+		const int64 ChunkSize = FMath::Min<int64>(Remaining, Buffer.Num());
+		Reader->Serialize(Buffer.GetData(), ChunkSize);
+		Crc = FCrc::MemCrc32(Buffer.GetData(), ChunkSize, Crc);
+		Remaining -= ChunkSize;
+	}
+
+	return !Reader->IsError() && Crc == Stat.crc;
+}
+
+bool FZipWriter::Rebuild(FZipError& Error)
+{
+	const TSharedPtr<FZipUpdateState> State = MoveTemp(UpdateState);
+
+	zip_discard(Zip);
+	Zip = nullptr;
+	DeflateQueue.Reset();
+
+	// Entries can't be reordered in place, the deterministic order needs a fresh zip
+	FZipWriter Writer{};
+	if (!TryCreateZipWriter(State->Path, Writer, Error))
+	{
+		return false;
+	}
+
+	Writer.SetDeterministic(bDeterministic);
+	for (const FZipUpdateFile& File : State->Files)
+	{
+		if (!Writer.AddFile(File.EntryName, File.SourcePath, File.Compression, Error))
+		{
+			return false;
+		}
+	}
+
+	return Writer.Close(Error);
+}
+
+FZipWriter::~FZipWriter()
+{
+	if (Zip)
+	{
+		zip_discard(Zip);
+	}
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "ModBuildAsyncAction.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FModBuildActionDelegate, const FString&, ModName);
+
+/**
+ * Latent Blueprint nodes for the background builds of UModBuilder.
+ * Unlike UModBuilder::BuildMod, ZipMod and PrepareModForRelease they wait for the build and report its result.
+ */
+UCLASS()
+class UModBuildAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	/** Builds the mod in the background */
+	UFUNCTION(BlueprintCallable, Category = "Mod Building", meta = (BlueprintInternalUseOnly = "true", DisplayName = "Build Mod (Async)"))
+	static UModBuildAsyncAction* BuildModAsync(const FString& ModName, bool bIsSameContentError = true);
+
+	/** Zips the mod, building it first if bAlwaysBuildBeforeZipping is set */
+	UFUNCTION(BlueprintCallable, Category = "Mod Building", meta = (BlueprintInternalUseOnly = "true", DisplayName = "Zip Mod (Async)"))
+	static UModBuildAsyncAction* ZipModAsync(const FString& ModName);
+
+	/** Prepares the mod for release, building it first if bAlwaysBuildBeforePrep is set */
+	UFUNCTION(BlueprintCallable, Category = "Mod Building", meta = (BlueprintInternalUseOnly = "true", DisplayName = "Prepare Mod For Release (Async)"))
+	static UModBuildAsyncAction* PrepareModForReleaseAsync(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies);
+
+	virtual void Activate() override;
+
+	UPROPERTY(BlueprintAssignable)
+	FModBuildActionDelegate OnSuccess;
+
+	UPROPERTY(BlueprintAssignable)
+	FModBuildActionDelegate OnFailure;
+
+private:
+	/** Called on the game thread once the work has finished */
+	void Finish(bool bSuccess);
+
+	/** Starts the work, the future is fulfilled on the game thread */
+	TFunction<TFuture<bool>()> Start;
+
+	FString ModName;
+};
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Build/ModBuildTypes.h"
+#include "Framework/Notifications/NotificationManager.h"
+
+#include <atomic>
+
+class SNotificationItem;
+
+/**
+ * Runs a build on a background thread and reports its state through a non-modal notification.
+ * All public functions except Start are thread safe and meant to be called from the work function.
+ */
+class FModBuildJob : public TSharedFromThis<FModBuildJob, ESPMode::ThreadSafe>
+{
+public:
+	typedef TFunction<FModBuildResult(FModBuildJob&)> FWork;
+
+	FModBuildJob(const FText& Title, FWork Work);
+
+	/**
+	 * Shows the notification and starts the work on a background thread.
+	 * Must be called from the game thread, the returned future is fulfilled on the game thread.
+	 */
+	TFuture<FModBuildResult> Start();
+
+	/** Requests the build to stop, running processes get terminated */
+	void Cancel();
+
+	bool IsCancelled() const { return bCancelRequested; }
+
+	/**
+	 * Enter a new stage of the build
+	 *
+	 * @param InStageText Text displayed in the notification
+	 * @param InProgress Overall progress of the build in the range [0, 1]
+	 * @param InProgressEnd Progress at the end of the stage, cook progress in the output moves the bar up to it
+	 */
+	void SetStage(const FText& InStageText, float InProgress, float InProgressEnd = -1.0f);
+
+	/**
+	 * Forwards a line of process output to the log and the notification.
+	 * Cook progress advances the progress bar, warnings and errors are added to the ModdingEx message log.
+	 */
+	void AddOutputLine(const FString& Line);
+
+	/** Name of the message log listing that receives the diagnostics of all builds */
+	static const FName MessageLogName;
+
+private:
+	FText GetStatusText() const;
+	void UpdateProgressNotification(float InProgress);
+	void AddDiagnostic(bool bIsError, const FString& Message, const FString& AssetPath);
+	void Finish(FModBuildResult Result);
+
+private:
+	FText Title;
+	FWork Work;
+
+	FThreadSafeBool bCancelRequested;
+
+	mutable FCriticalSection StatusLock;
+	FText StageText;
+	FString LastOutputLine;
+	float StageProgress = 0.0f;
+	float StageProgressEnd = -1.0f;
+
+	std::atomic<int32> NumWarnings = 0;
+	std::atomic<int32> NumErrors = 0;
+
+	TPromise<FModBuildResult> Promise;
+	double StartTime = 0.0;
+
+	// Game thread only
+	TSharedPtr<SNotificationItem> Notification;
+	FProgressNotificationHandle ProgressHandle;
+};
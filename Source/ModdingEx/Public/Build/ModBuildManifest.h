@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+struct FModBuildManifestEntry
+{
+	/** BLAKE3 hash of the source package file */
+	FString Hash;
+
+	/** Size and modification time of the file when it was hashed */
+	int64 Size = -1;
+	FDateTime Timestamp;
+
+	/** Hard package dependencies inside /Game */
+	TArray<FName> Dependencies;
+};
+
+/**
+ * State of a mod's source packages at the time of its last successful cook.
+ * Tracks the packages of the mod and every /Game package they hard reference, used to only recook what changed.
+ */
+class FModBuildManifest
+{
+public:
+	/** Intermediate/ModdingEx/<ModName>/BuildManifest.json */
+	static FString GetManifestPath(const FString& ModName);
+
+	/**
+	 * Hashes the packages of the mod and their dependencies, can be called from any thread
+	 *
+	 * @param Previous If set, hashes of files with the same size and timestamp are taken from it instead of reading the files
+	 */
+	static FModBuildManifest Capture(const FString& ModName, const FModBuildManifest* Previous = nullptr);
+
+	static bool Load(const FString& ModName, FModBuildManifest& OutManifest);
+
+	bool Save(const FString& ModName) const;
+
+	static void Delete(const FString& ModName);
+
+	/** BLAKE3 hash of the file as hex string, empty if it couldn't be read */
+	static FString HashFile(const FString& Filename);
+
+	/**
+	 * Packages of the mod that have to be recooked compared to the previous manifest.
+	 * That's every new or changed package plus everything that (transitively) references a changed or removed package.
+	 */
+	TArray<FString> GetDirtyModPackages(const FModBuildManifest& Previous) const;
+
+	/** Packages of the mod that were removed since the previous manifest */
+	TArray<FString> GetRemovedModPackages(const FModBuildManifest& Previous) const;
+
+	/** Nothing was added, changed or removed since the previous manifest */
+	bool IsUnchanged(const FModBuildManifest& Previous) const;
+
+private:
+	FString ModPath;
+
+	TMap<FName, FModBuildManifestEntry> Packages;
+};
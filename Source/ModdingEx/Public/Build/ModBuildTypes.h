@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Pak/ModPakWriter.h"
+
+/** What a cook should produce, shared by the cook worker and the one-shot cook commandlet */
+struct FModCookRequest
+{
+	/** Directories on disk that should be cooked */
+	TArray<FString> CookDirectories;
+
+	/** Long package names that should be cooked (including the packages they reference), passed as -Package */
+	TArray<FString> Packages;
+
+	/** Long package paths the worker rescans before cooking so new and deleted assets are picked up */
+	TArray<FString> ScanPaths;
+
+	/** Keep cooked packages from previous cooks instead of starting from a clean sandbox */
+	bool bIterate = false;
+
+	/** Only cook the requested packages and what they reference, skipping the project's maps and always cook directories */
+	bool bScoped = false;
+};
+
+struct FModBuildTarget
+{
+	FString ModName;
+
+	/** Path of the pak file to write */
+	FString OutputPath;
+
+	/** Resolved from the compression profile of the mod */
+	FModPakCompressionSettings Compression;
+
+	/** An earlier build exists, the build first checks if the mod changed since then */
+	bool bCheckUpToDate = false;
+};
+
+struct FModBuildResult
+{
+	FString ModName;
+
+	/** Path of the pak file that was written (or would have been written) */
+	FString OutputPath;
+
+	bool bSuccess = false;
+
+	/** The build was aborted by the user */
+	bool bCancelled = false;
+
+	/** The build finished but produced the same output as the previous one */
+	bool bContentUnchanged = false;
+
+	/** Reason why the build failed, empty on success */
+	FText Error;
+
+	double DurationSeconds = 0.0;
+
+public:
+	static FModBuildResult Success(const FString& ModName, const FString& OutputPath)
+	{
+		FModBuildResult Result;
+		Result.ModName = ModName;
+		Result.OutputPath = OutputPath;
+		Result.bSuccess = true;
+		return Result;
+	}
+
+	static FModBuildResult Failure(const FString& ModName, const FText& Error)
+	{
+		FModBuildResult Result;
+		Result.ModName = ModName;
+		Result.Error = Error;
+		return Result;
+	}
+
+	static FModBuildResult Cancelled(const FString& ModName)
+	{
+		FModBuildResult Result = Failure(ModName, FText::FromString("Build was cancelled"));
+		Result.bCancelled = true;
+		return Result;
+	}
+};
@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EModOutputLineType : uint8
+{
+	Plain,
+
+	/** Cooker progress, see CookedPackages and TotalPackages */
+	Progress,
+
+	Warning,
+	Error
+};
+
+struct FModParsedOutputLine
+{
+	EModOutputLineType Type = EModOutputLineType::Plain;
+
+	int32 CookedPackages = 0;
+	int32 TotalPackages = 0;
+
+	/** Message without the log category and severity, only set for warnings and errors */
+	FString Message;
+
+	/** First /Game path mentioned in a warning or error */
+	FString AssetPath;
+};
+
+/** Recognizes progress, warnings and errors in the output of the cook commandlet, the cook worker and UnrealPak */
+class FModCookOutputParser
+{
+public:
+	static FModParsedOutputLine Parse(FStringView Line);
+};
@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectSaveContext.h"
+#include "Build/ModBuildTypes.h"
+
+#include <atomic>
+
+class FModBuildJob;
+class FSocket;
+class FModProcessRunner;
+
+enum class EModCookWorkerResult : uint8
+{
+	Succeeded,
+	Failed,
+
+	/** The worker couldn't be started or died, the caller should fall back to a regular cook */
+	Unavailable
+};
+
+/**
+ * Long-lived UnrealEditor-Cmd process running UModCookWorkerCommandlet.
+ * The engine, asset registry and shader caches stay warm between builds, jobs are sent over a loopback socket.
+ */
+class FModCookWorker
+{
+public:
+	static FModCookWorker& Get();
+
+	~FModCookWorker();
+
+	/** Starts the worker in the background so the first build doesn't have to wait for it */
+	void Prewarm();
+
+	/**
+	 * Cooks the request on the worker, starts the worker if it isn't running yet.
+	 * Blocks until the cook has finished, don't call from the game thread.
+	 * The worker always cooks iteratively, requests without bIterate are Unavailable.
+	 */
+	EModCookWorkerResult Cook(const FModCookRequest& Request, FModBuildJob* Job);
+
+	/** Asks the worker to quit and terminates it if it doesn't, called from ShutdownModule */
+	void Shutdown();
+
+private:
+	FModCookWorker();
+
+	bool EnsureRunning(FModBuildJob* Job);
+	bool IsRunning();
+	void StopProcess();
+
+	/** The job the output of the worker is forwarded to */
+	void SetOutputJob(FModBuildJob* Job);
+
+	void OnPackageSaved(const FString& PackageFileName, UPackage* Package, FObjectPostSaveContext ObjectSaveContext);
+
+private:
+	/** Held for the whole duration of a cook or the worker startup */
+	FCriticalSection WorkerLock;
+
+	/** Only used while WorkerLock is held */
+	TUniquePtr<FModProcessRunner> Process;
+
+	/** Makes a running cook or startup stop the worker and release WorkerLock so Shutdown can take over */
+	std::atomic<bool> bShuttingDown = false;
+
+	FSocket* ListenSocket = nullptr;
+	FSocket* Connection = nullptr;
+	TArray<uint8> ReceiveBuffer;
+
+	FCriticalSection OutputJobLock;
+	FModBuildJob* OutputJob = nullptr;
+
+	int32 NextJobId = 1;
+
+	/** Packages saved in the editor since the last job, the worker has to reload them */
+	FCriticalSection SavedPackagesLock;
+	TSet<FString> SavedPackages;
+	FDelegateHandle PackageSavedHandle;
+};
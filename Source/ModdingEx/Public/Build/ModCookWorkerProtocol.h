@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+
+class FSocket;
+
+/**
+ * Messages between the editor and the cook worker are newline terminated UTF-8 JSON objects.
+ * Every message has a "type" field, see the constants below.
+ */
+namespace ModCookWorkerProtocol
+{
+	/** Worker -> Editor: the cook server is initialized and accepts jobs */
+	const inline FString Ready = TEXT("ready");
+
+	/** Editor -> Worker: cook the packages and directories in the message */
+	const inline FString Cook = TEXT("cook");
+
+	/** Editor -> Worker: abort the running cook */
+	const inline FString Cancel = TEXT("cancel");
+
+	/** Worker -> Editor: a cook job has finished */
+	const inline FString Result = TEXT("result");
+
+	/** Editor -> Worker: shut down the worker */
+	const inline FString Quit = TEXT("quit");
+
+	/** Command line switch the editor uses to pass the port the worker has to connect to */
+	const inline FString PortSwitch = TEXT("ModdingExPort=");
+
+	TSharedRef<FJsonObject> MakeMessage(const FString& Type);
+
+	bool SendMessage(FSocket& Socket, const TSharedRef<FJsonObject>& Message);
+
+	/**
+	 * Wait for the next message
+	 *
+	 * @param Buffer Receive buffer, has to be kept between calls since it can hold the start of the next message
+	 * @param OutMessage Gets set if a message was received
+	 * @param WaitTime Time to wait for data
+	 * @param bOutConnectionLost Gets set if the other side closed the connection
+	 * @return Returns if a message was received
+	 */
+	bool ReceiveMessage(FSocket& Socket, TArray<uint8>& Buffer, TSharedPtr<FJsonObject>& OutMessage,
+	                    const FTimespan& WaitTime, bool& bOutConnectionLost);
+}
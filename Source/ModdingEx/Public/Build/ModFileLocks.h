@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+struct FModLockingProcess
+{
+	uint32 ProcessId = 0;
+
+	/** Executable name, e.g. FModel.exe */
+	FString Name;
+};
+
+/** Finds the processes that keep a file open, so only those have to be stopped before the file is overwritten */
+class FModFileLocks
+{
+public:
+	/** True if another process has the file open, a missing file is never locked */
+	static bool IsFileLocked(const FString& Filename);
+
+	/**
+	 * Processes that have the file open.
+	 * Asks the Windows Restart Manager, elsewhere or if that fails the running processes are matched against the candidates.
+	 *
+	 * @param CandidateNames Executable names used by the fallback, the process list it scans is cached for a few seconds
+	 */
+	static TArray<FModLockingProcess> GetLockingProcesses(const FString& Filename, const TArray<FString>& CandidateNames);
+
+	/** Terminates the process and waits for it to exit so its handles are closed */
+	static bool TerminateProcess(const FModLockingProcess& Process);
+
+private:
+	static bool QueryRestartManager(const FString& Filename, TArray<FModLockingProcess>& OutProcesses);
+
+	static TArray<FModLockingProcess> GetRunningProcesses(const TArray<FString>& CandidateNames);
+
+	inline static FCriticalSection ProcessCacheLock;
+	inline static TArray<FModLockingProcess> CachedProcesses;
+	inline static double CachedProcessesTime = -1.0;
+};
@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Pak/ModPakWriter.h"
+
+struct FModPackManifestFile
+{
+	/** BLAKE3 hash of the cooked file */
+	FString Hash;
+
+	int64 Size = 0;
+
+	FDateTime Timestamp;
+};
+
+/**
+ * Cooked files that went into the last pak of a mod and the pak that was written from them.
+ * Compared before packing so an unchanged mod is detected without reading the pak and packing can be skipped.
+ */
+class FModPackManifest
+{
+public:
+	/** Intermediate/ModdingEx/<ModName>/PackManifest.json */
+	static FString GetManifestPath(const FString& ModName);
+
+	/**
+	 * Hashes the cooked files, can be called from any thread
+	 *
+	 * @param Previous If set, hashes of files with the same size and timestamp are taken from it instead of reading the files
+	 */
+	static FModPackManifest Capture(const TArray<FModPakFileEntry>& Files, const FModPakCompressionSettings& Compression, const FModPackManifest* Previous);
+
+	static bool Load(const FString& ModName, FModPackManifest& OutManifest);
+
+	bool Save(const FString& ModName) const;
+
+	static void Delete(const FString& ModName);
+
+	/** The same files with the same content were packed with the same compression */
+	bool HasSameContent(const FModPackManifest& Other) const;
+
+	/** Remembers the pak that was written from the files */
+	void SetPak(const FString& PakPath);
+
+	/** The pak at PakPath is still the one that was written from the files */
+	bool IsPakUpToDate(const FString& PakPath) const;
+
+	bool UsesCompression(const FModPakCompressionSettings& Compression) const { return CompressionKey == Compression.GetKey(); }
+
+	const TMap<FString, FModPackManifestFile>& GetFiles() const { return Files; }
+
+private:
+	FString CompressionKey;
+
+	/** Keyed by the path inside the pak */
+	TMap<FString, FModPackManifestFile> Files;
+
+	FString PakPath;
+	int64 PakSize = -1;
+	FDateTime PakTimestamp;
+};
@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+struct FModProcessPipeReader;
+
+/**
+ * Runs a child process and streams its stdout and stderr line by line.
+ * Every pipe gets its own reader thread that blocks on the pipe, lines arrive as soon as the process writes them
+ * and the remaining output is drained after the process exits.
+ */
+class FModProcessRunner
+{
+public:
+	/** Called on the reader thread of the pipe, the view is only valid for the duration of the call */
+	typedef TFunction<void(FStringView Line)> FOnOutputLine;
+
+	FModProcessRunner(const FString& Executable, const FString& Params);
+
+	/** Terminates the process if it is still running */
+	~FModProcessRunner();
+
+	FModProcessRunner(const FModProcessRunner&) = delete;
+	FModProcessRunner& operator=(const FModProcessRunner&) = delete;
+
+	/** Stderr is merged into stdout if no stderr callback is set */
+	void SetOnStdOut(FOnOutputLine Callback) { OnStdOut = MoveTemp(Callback); }
+	void SetOnStdErr(FOnOutputLine Callback) { OnStdErr = MoveTemp(Callback); }
+
+	bool Launch();
+
+	bool IsRunning();
+
+	/**
+	 * Blocks until the process exited and its output has been drained
+	 *
+	 * @param ShouldCancel Checked regularly while waiting, the process is terminated once it returns true
+	 * @return The exit code of the process, -1 if it was terminated
+	 */
+	int32 Wait(TFunctionRef<bool()> ShouldCancel);
+
+	int32 Wait() { return Wait([] { return false; }); }
+
+	void Terminate();
+
+private:
+	bool IsOutputDrained() const;
+
+private:
+	FString Executable;
+	FString Params;
+
+	FOnOutputLine OnStdOut;
+	FOnOutputLine OnStdErr;
+
+	FProcHandle Process;
+	bool bTerminated = false;
+
+	TSharedPtr<FModProcessPipeReader, ESPMode::ThreadSafe> StdOutReader;
+	TSharedPtr<FModProcessPipeReader, ESPMode::ThreadSafe> StdErrReader;
+
+	/** Triggered by the readers once their pipe is closed */
+	TSharedPtr<FEvent, ESPMode::ThreadSafe> OutputDrainedEvent;
+};
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ModCookWorkerCommandlet.generated.h"
+
+class FJsonObject;
+class FSocket;
+class ITargetPlatform;
+class UCookOnTheFlyServer;
+
+/**
+ * Cook worker started by FModCookWorker (-run=ModCookWorker).
+ * Connects back to the editor and keeps a cook server alive, cooking the jobs it receives until it is told to quit.
+ */
+UCLASS()
+class UModCookWorkerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UModCookWorkerCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	/** Cooks a job, returns false if the job was cancelled */
+	bool CookJob(UCookOnTheFlyServer& CookServer, ITargetPlatform& TargetPlatform, const FJsonObject& Job,
+	             FSocket& Socket, TArray<uint8>& ReceiveBuffer);
+};
@@ -1,17 +1,20 @@
 ﻿#pragma once
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
-#include "FileUtilities/ZipArchiveWriter.h"
+#include "Async/Future.h"
+#include "Build/ModBuildTypes.h"
+#include "Pak/ModPakWriter.h"
 #include "ModBuilder.generated.h"
 
+class FModBuildJob;
+class FModBuildManifest;
+
 UCLASS(Blueprintable)
 class UModBuilder : public UBlueprintFunctionLibrary
 {
 	GENERATED_BODY()
 	
 private:
-	static void EditDirectoriesToAlwaysCook(const FString& DirectoryToCook, const bool bShouldRemove = false);
-
 	static bool GetOutputPakDirectory(FString& OutDirectory, const FString& ModName);
 
 	/** Basic zip by getting the pak file from the build (game's Paks dir) and zipping */
@@ -32,17 +35,140 @@ private:
 
 	static FString* FindFStringPropertyValue(UObject* Object, const FName& PropertyName);
 
-	TPromise<bool> BuildModAsync(const FString& ModName, bool bForceRebuild);
+	/** Stops the processes from ProcessesToKill that have one of the output paks open */
+	static void KillBlockingProcesses(const TArray<FModBuildTarget>& Targets);
 
-public:
-	static bool ExecGenericCommand(const TCHAR* Command, const TCHAR* Params, int32* OutReturnCode, FString* OutStdOut, FString* OutStdErr);
+	/**
+	 * Checks that no build is running, resolves the output paths and compression and saves the packages, called on the game thread
+	 *
+	 * @param bForRelease Use the release compression profile for mods without their own profile
+	 */
+	static bool PrepareBuild(const TArray<FString>& ModNames, bool bForRelease, TArray<FModBuildTarget>& OutTargets, FText& OutError);
+
+	/** Compression settings of the profile the mod uses */
+	static FModPakCompressionSettings GetCompressionSettings(const FString& ModName, bool bForRelease);
+
+	/**
+	 * Runs all build stages, called on the build thread.
+	 * All mods are cooked together in a single cook, afterwards they are packed in parallel.
+	 */
+	static TArray<FModBuildResult> RunBuildMods(FModBuildJob& Job, const TArray<FModBuildTarget>& Targets, bool bIsSameContentError);
+
+	/** The pak and the manifests of an earlier build exist, only checks for the files so it is cheap enough for the game thread */
+	static bool HasPreviousBuild(const FModBuildTarget& Target);
+
+	/**
+	 * Checks the captured source packages against the last build, called on the build thread.
+	 * True if no package changed since the last build and the pak it wrote is still in place.
+	 */
+	static bool IsModUpToDate(const FModBuildTarget& Target, const FModBuildManifest& Manifest, const FModBuildManifest& PreviousManifest);
+
+	/**
+	 * Adds what has to be cooked for the mod to the request, returns false if the mod is up to date
+	 *
+	 * @param Manifest The current state of the mod's source packages
+	 * @param PreviousManifest The state at the last cook, if there is one
+	 */
+	static bool PrepareModCook(const FString& ModName, const FModBuildManifest& Manifest, const FModBuildManifest* PreviousManifest, FModCookRequest& Request);
+
+	/** Cooks on the cook worker if enabled, otherwise or if the worker is unavailable with the cook commandlet */
+	static bool CookMods(const FModCookRequest& Request, FModBuildJob& Job);
 
+	/** Packs the cooked files of the mod, skipped if they didn't change since the pak was written */
+	static FModBuildResult PackMod(FModBuildJob& Job, const FModBuildTarget& Target, bool bIsSameContentError);
+
+	static bool CookInternal(const FModCookRequest& Request, FModBuildJob* Job);
+
+	/** Removes the cooked files of packages that were deleted so they don't end up in the pak */
+	static void DeleteCookedPackages(const FString& CookedDir, const TArray<FString>& PackageNames);
+
+	static bool PackInternal(const FString& FilesPath, const FString& OutputPath, const FModPakCompressionSettings& Compression, FModBuildJob* Job);
+
+	static bool ZipBuiltMod(const FString& ModName);
+
+	/** Checks the pak against the pack manifest of the mod and warns if it wasn't written by the last build */
+	static void WarnIfPakOutdated(const FString& ModName, const FString& PakPath);
+
+	static bool PrepareBuiltModForRelease(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies);
+
+	/** The build that is currently running, only one build can run at a time */
+	inline static TSharedPtr<FModBuildJob, ESPMode::ThreadSafe> ActiveBuildJob;
+
+public:
+	/**
+	 * Runs a process and forwards its output line by line
+	 *
+	 * @param Job If set, output is forwarded to the job and the process gets terminated when the job is cancelled
+	 */
+	static bool ExecGenericCommand(const TCHAR* Command, const TCHAR* Params, int32* OutReturnCode, FString* OutStdOut, FString* OutStdErr, FModBuildJob* Job = nullptr);
+
+	/**
+	 * Builds the mod in the background without blocking the editor
+	 *
+	 * @param ModName Name of the mod folder in /Game/Mods
+	 * @param bIsSameContentError Treat an unchanged output as an error
+	 * @param bForRelease Use the release compression profile unless the mod has its own profile
+	 * @return Future that is fulfilled on the game thread once the build has finished
+	 */
+	static TFuture<FModBuildResult> BuildModAsync(const FString& ModName, bool bIsSameContentError = true, bool bForRelease = false);
+
+	/**
+	 * Builds multiple mods in the background, cooking them together and packing them in parallel
+	 *
+	 * @return Future with the result of every mod, fulfilled on the game thread once all mods have been built
+	 */
+	static TFuture<TArray<FModBuildResult>> BuildModsAsync(const TArray<FString>& ModNames, bool bIsSameContentError = false);
+
+	/**
+	 * Builds the mod in the background if bAlwaysBuildBeforePrep is set, then writes the release files
+	 *
+	 * @return Future that is fulfilled on the game thread once the mod has been prepared, false if building or preparing failed
+	 */
+	static TFuture<bool> PrepareModForReleaseAsync(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies);
+
+	/**
+	 * Builds the mod in the background if bAlwaysBuildBeforeZipping is set, then zips it
+	 *
+	 * @return Future that is fulfilled on the game thread once the zip has been written, false if building or zipping failed
+	 */
+	static TFuture<bool> ZipModAsync(const FString& ModName);
+
+	static bool IsBuildRunning() { return ActiveBuildJob.IsValid(); }
+
+	/**
+	 * Lists the cooked files below RootDir/TrackingDir with their path inside the pak, sorted by that path.
+	 * The subdirectories are walked in parallel.
+	 */
+	static TArray<FModPakFileEntry> GetCookedFiles(const FString& RootDir, const FString& TrackingDir);
+
+	/**
+	 * Streams the response file for UnrealPak to a temp file
+	 *
+	 * @param bQuiet Only log a summary instead of every entry
+	 * @return Path of the response file or an empty string on failure
+	 */
+	static FString WriteFilesTxt(const TArray<FModPakFileEntry>& Files, const FModPakCompressionSettings& Compression, bool bQuiet = true);
+
+	/**
+	 * Starts building the mod in the background. Returns false if the build couldn't be started.
+	 * The build no longer finishes before this returns, Blueprints that need its result use the Build Mod (Async) node.
+	 */
 	UFUNCTION(BlueprintCallable, Category = "Mod Building")
 	static bool BuildMod(const FString& ModName, bool bIsSameContentError = true);
 
+	/**
+	 * Prepares the mod for release, building it first in the background if bAlwaysBuildBeforePrep is set.
+	 * Returns false if preparing failed or the build couldn't be started, the result of a background build is only logged.
+	 * Use PrepareModForReleaseAsync or the Prepare Mod For Release (Async) node to wait for it.
+	 */
 	UFUNCTION(BlueprintCallable, Category = "Mod Building")
 	static bool PrepareModForRelease(const FString& ModName, const FString& WebsiteUrl, const FString& Dependencies);
 
+	/**
+	 * Zips the mod, building it first in the background if bAlwaysBuildBeforeZipping is set.
+	 * Returns false if zipping failed or the build couldn't be started, the result of a background build is only logged.
+	 * Use ZipModAsync or the Zip Mod (Async) node to wait for it.
+	 */
 	UFUNCTION(BlueprintCallable, Category = "Mod Building")
 	static bool ZipMod(const FString& ModName);
 
@@ -59,5 +185,5 @@ public:
 	static bool Cook();
 
 	UFUNCTION(BlueprintCallable, Category = "Mod Building")
-	static FString CreateFilesTxt(const FString& RootDir, const FString& TrackingDir);
+	static FString CreateFilesTxt(const FString& RootDir, const FString& TrackingDir, bool bQuiet = true);
 };
@@ -24,6 +24,7 @@ public:
 	void OnOpenBlueprintCreator() const;
 	void OnOpenModCreator() const;
 	void OnOpenPrepareModForRelease(const FString& Mod) const;
+	void OnOpenBuildSelectedMods() const;
 	FReply TryStartGame() const;
 	void OnOpenGameFolder() const;
 	void OnOpenRepository() const;
@@ -70,6 +70,56 @@ struct FThunderstoreManifestDetailed
 	TArray<FString> Dependencies;
 };
 
+UENUM()
+enum class EModPakCompressionFormat : uint8
+{
+	None UMETA(DisplayName = "None"),
+	Oodle UMETA(DisplayName = "Oodle"),
+	Zlib UMETA(DisplayName = "Zlib")
+};
+
+/** Oodle compressors offered in the compression profiles, NotSet uses Kraken */
+UENUM()
+enum class EModOodleCompressor : uint8
+{
+	NotSet = 0 UMETA(Hidden),
+	Selkie = 1 UMETA(DisplayName = "Selkie"),
+	Mermaid = 2 UMETA(DisplayName = "Mermaid"),
+	Kraken = 3 UMETA(DisplayName = "Kraken"),
+	Leviathan = 4 UMETA(DisplayName = "Leviathan")
+};
+
+USTRUCT()
+struct FModPakCompressionProfile
+{
+	GENERATED_BODY()
+
+	FModPakCompressionProfile() = default;
+
+	FModPakCompressionProfile(EModPakCompressionFormat InFormat, EModOodleCompressor InCompressor, int32 InLevel)
+		: Format(InFormat), Compressor(InCompressor), Level(InLevel)
+	{
+	}
+
+	UPROPERTY(EditAnywhere)
+	EModPakCompressionFormat Format = EModPakCompressionFormat::Oodle;
+
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Format == EModPakCompressionFormat::Oodle", EditConditionHides))
+	EModOodleCompressor Compressor = EModOodleCompressor::Kraken;
+
+	/** Oodle level, from -4 (hyper fast) over 4 (normal) to 9 (optimal 5) */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Format == EModPakCompressionFormat::Oodle", EditConditionHides, ClampMin = "-4", ClampMax = "9"))
+	int32 Level = 5;
+
+	/** Size of the blocks files are split into, every block is compressed on its own */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Format != EModPakCompressionFormat::None", EditConditionHides, ClampMin = "16", ClampMax = "4096"))
+	int32 BlockSizeKB = 64;
+
+	/** Stores files listed in CompressedMediaExtensions without compressing them again */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "Format != EModPakCompressionFormat::None", EditConditionHides))
+	bool bSkipCompressedMedia = true;
+};
+
 UCLASS(Config=Editor)
 class UModdingExSettings : public UObject
 {
@@ -113,6 +163,69 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Building")
 	bool bSaveAllBeforeBuilding = true;
 
+	/** Only cooks the mod that is being built and what it references instead of every map and always cook directory of the project */
+	UPROPERTY(Config, EditAnywhere, Category = "Building")
+	bool bScopedCook = true;
+
+	/** Keeps a cook process running in the background so builds don't have to start the engine every time */
+	UPROPERTY(Config, EditAnywhere, Category = "Building")
+	bool bUsePersistentCookWorker = true;
+
+	/** Starts the cook worker when the editor opens instead of on the first build */
+	UPROPERTY(Config, EditAnywhere, Category = "Building", meta = (EditCondition = "bUsePersistentCookWorker"))
+	bool bPrewarmCookWorkerOnStartup = false;
+
+	/** Seconds to wait for the cook worker to start before falling back to a regular cook */
+	UPROPERTY(Config, EditAnywhere, Category = "Building", meta = (EditCondition = "bUsePersistentCookWorker", ClampMin = "10"))
+	float CookWorkerStartupTimeout = 300.f;
+
+	/** Packs with UnrealPak.exe instead of writing the pak in the editor */
+	UPROPERTY(Config, EditAnywhere, Category = "Building")
+	bool bUseUnrealPak = false;
+
+	/** Keeps compressed pak blocks in Intermediate/ModdingEx/PakCache so unchanged files don't have to be compressed again */
+	UPROPERTY(Config, EditAnywhere, Category = "Building", meta = (EditCondition = "!bUseUnrealPak"))
+	bool bUsePakCache = true;
+
+	/** Size in MB the pak cache is trimmed to after packing, least recently used entries are removed first */
+	UPROPERTY(Config, EditAnywhere, Category = "Building", meta = (EditCondition = "!bUseUnrealPak && bUsePakCache", ClampMin = "0"))
+	int32 PakCacheSizeLimitMB = 4096;
+
+	/** Compression settings used when packing, the key is the name of the profile */
+	UPROPERTY(Config, EditAnywhere, Category = "Compression")
+	TMap<FName, FModPakCompressionProfile> CompressionProfiles = {
+		{ FName("Fast Iteration"), { EModPakCompressionFormat::Oodle, EModOodleCompressor::Selkie, 1 } },
+		{ FName("Release"), { EModPakCompressionFormat::Oodle, EModOodleCompressor::Leviathan, 7 } },
+		{ FName("Custom"), { EModPakCompressionFormat::Oodle, EModOodleCompressor::Kraken, 5 } }
+	};
+
+	/** Profile used when building a mod */
+	UPROPERTY(Config, EditAnywhere, Category = "Compression", meta = (GetOptions = "GetCompressionProfileNames"))
+	FName DefaultCompressionProfile = "Fast Iteration";
+
+	/** Profile used when building a mod before zipping it or preparing it for release */
+	UPROPERTY(Config, EditAnywhere, Category = "Compression", meta = (GetOptions = "GetCompressionProfileNames"))
+	FName ReleaseCompressionProfile = "Release";
+
+	/** Profile per mod (name of the mod folder), used for every build of that mod instead of the default and release profile */
+	UPROPERTY(Config, EditAnywhere, Category = "Compression")
+	TMap<FString, FName> ModCompressionProfiles;
+
+	/** Extensions of files that are already compressed, profiles can store them as they are */
+	UPROPERTY(Config, EditAnywhere, Category = "Compression")
+	TArray<FString> CompressedMediaExtensions = { "bk2", "mp4", "wem", "bnk", "ogg", "mp3" };
+
+	UFUNCTION()
+	TArray<FString> GetCompressionProfileNames() const
+	{
+		TArray<FString> Names;
+		for (const TPair<FName, FModPakCompressionProfile>& Profile : CompressionProfiles)
+		{
+			Names.Add(Profile.Key.ToString());
+		}
+		return Names;
+	}
+
 	/** If you are uploading your mod on Curseforge */
 	UPROPERTY(Config, EditAnywhere, Category = "Mod Manager")
 	bool bUsingCurseforge = true;
@@ -145,7 +258,15 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Zipping")
 	bool bOpenZipFolderAfterZipping = true;
 
-	/** If true checks the hash of the output file before and after building to check if stuff has changed */
+	/** If true zipping the same files always gives the same zip, entries are sorted and get a fixed timestamp */
+	UPROPERTY(Config, EditAnywhere, Category = "Zipping")
+	bool bDeterministicZips = true;
+
+	/** If true an existing zip is updated, files that didn't change keep their compressed data instead of being compressed again */
+	UPROPERTY(Config, EditAnywhere, Category = "Zipping")
+	bool bUpdateExistingZips = true;
+
+	/** If true compares the cooked files with the last build to check if stuff has changed, packing is skipped if nothing did */
 	UPROPERTY(Config, EditAnywhere, Category = "Hash Check")
 	bool bShouldCheckHash = true;
 
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Hash/Blake3.h"
+
+struct FModPakCompressionSettings;
+
+/**
+ * Cache of compressed pak blocks, stored in Intermediate/ModdingEx/PakCache.
+ * Entries are keyed by the hash of the uncompressed file and the compression settings,
+ * so unchanged files don't have to be compressed again when a mod is repacked.
+ * Loading and storing can be called from any thread.
+ */
+class FModPakBlockCache
+{
+public:
+	explicit FModPakBlockCache(const FModPakCompressionSettings& Compression);
+
+	static FString GetCacheDir();
+
+	FBlake3Hash MakeKey(const TArray<uint8>& Uncompressed) const;
+
+	/**
+	 * Loads the compressed blocks of a file
+	 *
+	 * @param OutBlocks Compressed blocks, empty if the file is stored uncompressed
+	 * @return Returns false if the file isn't cached
+	 */
+	bool Load(const FBlake3Hash& Key, int64 UncompressedSize, TArray<TArray<uint8>>& OutBlocks) const;
+
+	void Store(const FBlake3Hash& Key, int64 UncompressedSize, const TArray<TArray<uint8>>& Blocks) const;
+
+	/** Deletes the least recently used entries until the cache is smaller than MaxSize */
+	static void Trim(int64 MaxSize);
+
+private:
+	FString GetEntryPath(const FBlake3Hash& Key) const;
+
+	/** Hash of the compression settings, mixed into every key */
+	FBlake3Hash SettingsHash;
+};
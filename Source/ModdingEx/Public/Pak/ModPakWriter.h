@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Compression/OodleDataCompression.h"
+
+class FModPakBlockCache;
+
+struct FModPakFileEntry
+{
+	/** Absolute path of the cooked file on disk */
+	FString SourcePath;
+
+	/** Path inside the pak relative to the engine root, e.g. Pal/Content/Mods/MyMod/BP_MyMod.uasset */
+	FString DestPath;
+};
+
+struct FModPakCompressionSettings
+{
+	/** NAME_Oodle, NAME_Zlib or NAME_None to store the files uncompressed */
+	FName Format = NAME_Oodle;
+
+	/** Only used for Oodle */
+	FOodleDataCompression::ECompressor Compressor = FOodleDataCompression::ECompressor::Kraken;
+	FOodleDataCompression::ECompressionLevel Level = FOodleDataCompression::ECompressionLevel::Optimal1;
+
+	/** Every block is compressed on its own so the game can decompress only the blocks it reads */
+	int32 BlockSize = 64 * 1024;
+
+	/** Files with these extensions are stored uncompressed, e.g. media that is already compressed */
+	TArray<FString> UncompressedExtensions;
+
+	/** Describes everything that affects the written data, paks and blocks written with the same key are identical */
+	FString GetKey() const;
+};
+
+/**
+ * Writes .pak files in process.
+ * Files are read in batches, their blocks are compressed in parallel on the task graph and then written in order.
+ * Large files are streamed a chunk at a time, and all writers share one budget for the file data they hold in memory.
+ */
+class FModPakWriter
+{
+public:
+	/** Alignment of small entries, also passed to UnrealPak as -patchpaddingalign so both produce the same layout */
+	static constexpr int64 PatchPaddingAlign = 2048;
+
+	/**
+	 * Writes a pak file containing the given files
+	 *
+	 * @param OutputPath Path of the pak, it is only replaced once the new pak was written completely
+	 * @param Cache If set, compressed blocks of unchanged files are taken from the cache and new ones are added to it
+	 * @param ShouldCancel Checked between batches, cancelling leaves the existing pak untouched
+	 * @param OutError Reason why writing failed
+	 * @return Returns if the pak was written
+	 */
+	static bool WritePak(const FString& OutputPath, const TArray<FModPakFileEntry>& Files, const FModPakCompressionSettings& Compression,
+	                     const FModPakBlockCache* Cache, TFunctionRef<bool()> ShouldCancel, FString& OutError);
+};
@@ -23,11 +23,13 @@ struct FSourceEntry
 {
 	FString Name;
 	FString SearchPath;
-	TArray<uint8> Data;
 
-	FSourceEntry(FString Name, FString SearchPath, TArray<uint8> Data) : Name(MoveTemp(Name)),
-	                                                                     SearchPath(MoveTemp(SearchPath)),
-	                                                                     Data(MoveTemp(Data))
+	/** Index in the downloaded zip, the entry is extracted straight to disk */
+	uint64 EntryIndex;
+
+	FSourceEntry(FString Name, FString SearchPath, uint64 EntryIndex) : Name(MoveTemp(Name)),
+	                                                                    SearchPath(MoveTemp(SearchPath)),
+	                                                                    EntryIndex(EntryIndex)
 	{
 	}
 };
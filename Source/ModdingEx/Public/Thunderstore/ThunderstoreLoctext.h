@@ -32,6 +32,7 @@ namespace ThunderstoreLoctext
 	const inline FText FailedToUnloadPackages = LOCTEXT("UnloadFailed",
 	                                                 "Failed to unload all packages");
 
+	const inline FText ExtractingSources = LOCTEXT("ExtractingSources", "Extracting sources ({0} / {1})");
 	const inline FText FailedToSave = LOCTEXT("FailedToSave", "Failed to save some files");
 	const inline FText FailedToReload = LOCTEXT("FailedToReload", "Failed to reload some assets");
 
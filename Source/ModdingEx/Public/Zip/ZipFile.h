@@ -2,6 +2,7 @@
 #include <utility>
 
 #include "zip.h"
+#include "Async/MappedFileHandle.h"
 
 
 struct FZipError
@@ -10,6 +11,8 @@ struct FZipError
 	TOptional<FString> Description;
 };
 
+FZipError CreateError(const zip_error_t Error);
+
 class FZipBuffer
 {
 public:
@@ -23,19 +26,49 @@ public:
 	 */
 	static bool TryCreateZipBuffer(const TArray<uint8>& Data, FZipBuffer& ZipBuffer, FZipError& Error);
 
+	/**
+	 * Try to create a zip buffer for a file on disk without loading it.
+	 * The file is mapped into memory, if that isn't possible it is read through a file handle when needed.
+	 *
+	 * @param Path File to use
+	 * @param ZipBuffer Result buffer, gets set if creation succeeded
+	 * @param Error Error information, gets set if creation failed
+	 * @return Returns if the creation was successful
+	 */
+	static bool TryCreateZipBuffer(const FString& Path, FZipBuffer& ZipBuffer, FZipError& Error);
+
+	/**
+	 * Try to create another buffer on the same data, so a zip can be opened on it for another thread
+	 *
+	 * @param ZipBuffer Result buffer, must not outlive this one
+	 * @param Error Error information, gets set if creation failed
+	 * @return Returns if the creation was successful
+	 */
+	bool TryDuplicate(FZipBuffer& ZipBuffer, FZipError& Error) const;
+
 public:
 	FZipBuffer() = default;
 
 	FZipBuffer(const FZipBuffer&) = delete;
 	FZipBuffer& operator=(const FZipBuffer&) = delete;
 
-	FZipBuffer(FZipBuffer&& Other) noexcept : Source(std::exchange(Other.Source, nullptr))
+	FZipBuffer(FZipBuffer&& Other) noexcept : Source(std::exchange(Other.Source, nullptr)),
+	                                          Data(std::exchange(Other.Data, nullptr)),
+	                                          DataSize(std::exchange(Other.DataSize, 0)),
+	                                          Path(std::exchange(Other.Path, {})),
+	                                          MappedFile(MoveTemp(Other.MappedFile)),
+	                                          MappedRegion(MoveTemp(Other.MappedRegion))
 	{
 	}
 
 	FZipBuffer& operator=(FZipBuffer&& Other) noexcept
 	{
 		Swap(Source, Other.Source);
+		Swap(Data, Other.Data);
+		Swap(DataSize, Other.DataSize);
+		Swap(Path, Other.Path);
+		Swap(MappedFile, Other.MappedFile);
+		Swap(MappedRegion, Other.MappedRegion);
 		return *this;
 	}
 
@@ -47,18 +80,35 @@ private:
 	}
 
 private:
-	zip_source_t* Source;
+	/** The zip opened on it holds its own reference */
+	zip_source_t* Source = nullptr;
+
+	/** Memory the source reads from, unless it reads through a file handle */
+	const uint8* Data = nullptr;
+	int64 DataSize = 0;
+
+	/** File the source reads from through a file handle */
+	FString Path;
+
+	/** Set if the source reads from a mapped file, the region is unmapped before the file is closed */
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
 
 private:
 	friend class FZipFile;
 };
 
+/** Metadata of an entry, its decompression stream is only opened once the entry is read */
 struct FZipEntry
 {
 	TOptional<FString> Name;
 	uint64 Index;
 	uint64 DecompressedSize;
 	uint64 CompressedSize;
+	uint32 Crc;
+
+	/** ZIP_CM_* */
+	uint16 CompressionMethod;
 
 public:
 	FZipEntry() = default;
@@ -69,6 +119,8 @@ public:
 	FZipEntry(FZipEntry&& Other) noexcept : Name(std::exchange(Other.Name, {})), Index(std::exchange(Other.Index, {})),
 	                                        DecompressedSize(std::exchange(Other.DecompressedSize, {})),
 	                                        CompressedSize(std::exchange(Other.CompressedSize, {})),
+	                                        Crc(std::exchange(Other.Crc, {})),
+	                                        CompressionMethod(std::exchange(Other.CompressionMethod, {})),
 	                                        File(std::exchange(Other.File, nullptr))
 	{
 	}
@@ -79,6 +131,8 @@ public:
 		Swap(Index, Other.Index);
 		Swap(DecompressedSize, Other.DecompressedSize);
 		Swap(CompressedSize, Other.CompressedSize);
+		Swap(Crc, Other.Crc);
+		Swap(CompressionMethod, Other.CompressionMethod);
 		Swap(File, Other.File);
 		return *this;
 	}
@@ -92,12 +146,34 @@ public:
 	}
 
 private:
-	zip_file_t* File;
+	/** Opened on the first read */
+	mutable zip_file_t* File = nullptr;
 
 private:
 	friend class FZipFile;
 };
 
+/** Entry in the name index of a zip */
+struct FZipIndexEntry
+{
+	FString Name;
+	uint64 Index;
+};
+
+/** Entry to extract and the file it is written to */
+struct FZipExtractEntry
+{
+	uint64 Index;
+	FString Path;
+};
+
+/** Names inside a zip are case sensitive */
+struct FZipNameKeyFuncs : TDefaultMapKeyFuncs<FString, int32, false>
+{
+	static bool Matches(const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+	static uint32 GetKeyHash(const FString& Key) { return FCrc::StrCrc32(*Key); }
+};
+
 class FZipFile
 {
 public:
@@ -111,6 +187,16 @@ public:
 	 */
 	static bool TryCreateZipFile(const TArray<uint8>& Data, FZipFile& ZipFile, FZipError& Error);
 
+	/**
+	 * Try to open a zip file on disk, entries are read from it when needed instead of loading the whole file
+	 *
+	 * @param Path Zip file to open
+	 * @param ZipFile Result file, gets set if creation succeeded
+	 * @param Error Error, gets set if creation failed
+	 * @return Returns if the creation was successful
+	 */
+	static bool TryCreateZipFile(const FString& Path, FZipFile& ZipFile, FZipError& Error);
+
 public:
 	/**
 	 * 
@@ -135,9 +221,69 @@ public:
 	 * @return All zip entries
 	 */
 	TArray<FZipEntry> GetEntries(FZipError& Error) const;
+
+	/**
+	 * Looks the name up in the index built when the zip was opened
+	 *
+	 * @param Name Entry name
+	 * @return Entry index, if one exists
+	 */
+	TOptional<uint64> FindEntryIndex(const FString& Name) const;
+
+	/**
+	 * Entries whose name starts with the prefix, e.g. "Sources/" for everything in that directory
+	 *
+	 * @param Prefix Case sensitive start of the names
+	 * @return Entries sorted by name, valid as long as the zip is
+	 */
+	TArrayView<const FZipIndexEntry> FindEntriesWithPrefix(FStringView Prefix) const;
+
+	/**
+	 * Entries whose name starts with the prefix in any casing, e.g. "Sources/" also finds "sources/" and "SOURCES/"
+	 *
+	 * @param Prefix Case insensitive start of the names
+	 * @return Entries sorted by name ignoring case
+	 */
+	TArray<FZipIndexEntry> FindEntriesWithPrefixIgnoreCase(FStringView Prefix) const;
 	
 	TArray<uint8> ReadEntry(const FZipEntry& Entry) const;
 
+	/**
+	 * Decompresses the entry straight into the buffer
+	 *
+	 * @param Entry Entry to read
+	 * @param Destination Buffer of DecompressedSize bytes
+	 * @return Returns if the whole entry was read
+	 */
+	bool ReadEntryInto(const FZipEntry& Entry, TArrayView64<uint8> Destination) const;
+
+	/**
+	 * Streams the entry, it is decompressed while it is read
+	 *
+	 * @param Entry Entry to read
+	 * @return Reader, null if the entry couldn't be opened, must not outlive the zip
+	 */
+	TUniquePtr<FArchive> CreateEntryReader(const FZipEntry& Entry) const;
+
+	/**
+	 * Decompresses the entry to a file in chunks
+	 *
+	 * @param Entry Entry to extract
+	 * @param Path File to write, gets replaced if it exists
+	 * @return Returns if the whole entry was written
+	 */
+	bool ExtractEntry(const FZipEntry& Entry, const FString& Path) const;
+
+	/**
+	 * Extracts the entries in parallel on the thread pool, every worker reads through its own zip on the same data
+	 *
+	 * @param Entries Entries and the files they are written to
+	 * @param OnProgress Called on the calling thread with the bytes written so far and the bytes to write in total
+	 * @param Error Error of the first entry that failed, the others are still extracted
+	 * @return Returns if every entry was extracted
+	 */
+	bool ExtractEntries(const TArray<FZipExtractEntry>& Entries, TFunctionRef<void(int64, int64)> OnProgress, FZipError& Error) const;
+
 public:
 	FZipFile() = default;
 
@@ -145,7 +291,10 @@ public:
 	FZipFile& operator=(const FZipFile&) = delete;
 
 	FZipFile(FZipFile&& Other) noexcept : Buffer(std::exchange(Other.Buffer, {})),
-	                                      Zip(std::exchange(Other.Zip, nullptr))
+	                                      Zip(std::exchange(Other.Zip, nullptr)),
+	                                      SortedEntries(std::exchange(Other.SortedEntries, {})),
+	                                      EntryLookup(std::exchange(Other.EntryLookup, {})),
+	                                      SortedIgnoreCase(std::exchange(Other.SortedIgnoreCase, {}))
 	{
 	}
 
@@ -153,6 +302,9 @@ public:
 	{
 		Swap(Buffer, Other.Buffer);
 		Swap(Zip, Other.Zip);
+		Swap(SortedEntries, Other.SortedEntries);
+		Swap(EntryLookup, Other.EntryLookup);
+		Swap(SortedIgnoreCase, Other.SortedIgnoreCase);
 		return *this;
 	}
 
@@ -163,7 +315,22 @@ private:
 	{
 	}
 
+	/** Opens the zip on the buffer and reads the names from its central directory */
+	static bool TryCreateZipFile(FZipBuffer Buffer, FZipFile& ZipFile, FZipError& Error);
+
+	/** Reads the names from the central directory */
+	void BuildIndex();
+
 private:
 	FZipBuffer Buffer;
 	zip_t* Zip;
+
+	/** All entries sorted by name for prefix queries */
+	TArray<FZipIndexEntry> SortedEntries;
+
+	/** Name to position in SortedEntries */
+	TMap<FString, int32, FDefaultSetAllocator, FZipNameKeyFuncs> EntryLookup;
+
+	/** Positions in SortedEntries sorted by name ignoring case, for case insensitive prefix queries */
+	TArray<int32> SortedIgnoreCase;
 };
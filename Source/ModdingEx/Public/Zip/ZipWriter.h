@@ -0,0 +1,126 @@
+﻿#pragma once
+#include <utility>
+
+#include "zip.h"
+#include "Zip/ZipFile.h"
+
+enum class EZipCompression : uint8
+{
+	Deflate,
+	/** Stored as is, for data that is already compressed */
+	Store
+};
+
+class FZipDeflateQueue;
+struct FZipUpdateState;
+
+/**
+ * Writes a zip to disk.
+ * Added files are only read when the zip is closed.
+ * Deflated files are split into chunks that are deflated on the thread pool ahead of being written, a bounded amount
+ * at a time. The deflated data of large files goes through a temporary file, so memory use doesn't depend on the size of the files.
+ */
+class FZipWriter
+{
+public:
+	/**
+	 * Try to create a zip writer, an existing file at the path is replaced once the writer is closed
+	 *
+	 * @param Path File to write the zip to
+	 * @param Writer Result writer, gets set if creation succeeded
+	 * @param Error Error, gets set if creation failed
+	 * @return Returns if the creation was successful
+	 */
+	static bool TryCreateZipWriter(const FString& Path, FZipWriter& Writer, FZipError& Error);
+
+	/**
+	 * Try to create a zip writer that updates the zip at the path, or creates it if there is none.
+	 * Added files whose size and crc match the existing entry keep their compressed data, entries that aren't added
+	 * again are removed on close.
+	 *
+	 * @param Path Zip to update
+	 * @param Writer Result writer, gets set if creation succeeded
+	 * @param Error Error, gets set if the zip couldn't be opened
+	 * @return Returns if the creation was successful
+	 */
+	static bool TryUpdateZipWriter(const FString& Path, FZipWriter& Writer, FZipError& Error);
+
+	/**
+	 * Compresses a few samples of the file to see if deflating it is worth the time
+	 *
+	 * @param SourcePath File to probe
+	 * @return False if the samples barely got smaller, e.g. for paks or media that are compressed already
+	 */
+	static bool IsWorthCompressing(const FString& SourcePath);
+
+public:
+	/**
+	 * Add a file from disk, it is read when the zip is closed
+	 *
+	 * @param EntryName Path inside the zip
+	 * @param SourcePath File to add
+	 * @param Compression How the file is stored in the zip
+	 * @param Error Error, gets set if adding failed
+	 * @return Returns if the file was added
+	 */
+	bool AddFile(const FString& EntryName, const FString& SourcePath, EZipCompression Compression, FZipError& Error);
+
+	/**
+	 * Files added afterwards get a fixed timestamp and fixed attributes instead of the ones of the source file.
+	 * Together with adding the files in a stable order the same files always give the same zip.
+	 */
+	void SetDeterministic(bool bInDeterministic) { bDeterministic = bInDeterministic; }
+
+	/**
+	 * Writes the zip and closes the writer
+	 *
+	 * @param Error Error, gets set if writing failed
+	 * @return Returns if the zip was written
+	 */
+	bool Close(FZipError& Error);
+
+public:
+	FZipWriter() = default;
+
+	FZipWriter(const FZipWriter&) = delete;
+	FZipWriter& operator=(const FZipWriter&) = delete;
+
+	FZipWriter(FZipWriter&& Other) noexcept : Zip(std::exchange(Other.Zip, nullptr)),
+	                                          DeflateQueue(std::exchange(Other.DeflateQueue, nullptr)),
+	                                          UpdateState(std::exchange(Other.UpdateState, nullptr)),
+	                                          bDeterministic(std::exchange(Other.bDeterministic, false))
+	{
+	}
+
+	FZipWriter& operator=(FZipWriter&& Other) noexcept
+	{
+		Swap(Zip, Other.Zip);
+		Swap(DeflateQueue, Other.DeflateQueue);
+		Swap(UpdateState, Other.UpdateState);
+		Swap(bDeterministic, Other.bDeterministic);
+		return *this;
+	}
+
+	/** Discards the zip if it wasn't closed */
+	~FZipWriter();
+
+private:
+	FZipWriter(zip_t* Zip) : Zip(Zip)
+	{
+	}
+
+	bool IsSameFile(zip_int64_t Index, const FString& SourcePath, int64 Size) const;
+
+	/** Writes everything that was added to a fresh zip instead of updating the existing one */
+	bool Rebuild(FZipError& Error);
+
+private:
+	zip_t* Zip = nullptr;
+
+	TSharedPtr<FZipDeflateQueue> DeflateQueue;
+
+	/** Only set when updating an existing zip */
+	TSharedPtr<FZipUpdateState> UpdateState;
+
+	bool bDeterministic = false;
+};